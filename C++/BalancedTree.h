@@ -0,0 +1,1999 @@
+// BalancedTree.h
+// Partially rebuilt binary search tree, specialized at compile time by
+//   BalancePolicy   : when a subtree is rebuilt (WeightBalance or ScapegoatBalance, or their Fixed versions with a compile-time alpha),
+//                     or RotationBalance to rebalance by rotations instead
+//   RebuildExecutor : how a rebuild is carried out (SerialRebuild or PoolRebuild)
+//   Aggregate       : what every node sums up about its subtree for rangeAggregate (NoAggregate, SumAggregate, MinAggregate, MaxAggregate)
+//   SizeT           : signed integer type of subtree sizes, counts and rebuild indices. int keeps nodes compact,
+//                     long long is needed beyond 2^31 - 1 keys. Inserting into a full tree throws length_error.
+//   Counted         : whether nodes hold a copy count and a total, which multiset and lazy delete mode need. Other trees leave them out.
+// WBTree.h, WBTreeP.h, WBTreeTP.h, WBTreeR.h, Scapegoat.h and ScapegoatP.h name its common combinations.
+#ifndef BALANCEDTREE_H
+#define BALANCEDTREE_H
+
+#define BATCH_GROUP 16		// Number of lookups searchBatch keeps in flight
+#define APPEND_RUN 4		// Consecutive appends after which the rightmost path is cached
+#define ADAPT_WINDOW 65536	// Minimum number of operations per window in adaptive mode
+#define ADAPT_STEP 0.125	// Smallest change of alpha in adaptive mode, as a fraction of the range it may take
+#define CACHE_LINE 64		// Bytes per cache line. The frozen array is aligned to it and prefetched a line ahead.
+#define FROZEN_SIMD_MAX 262144	// Largest frozen array of int keys searched with AVX2. Larger ones miss the cache, where the prefetching scalar loop wins.
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FROZEN_AVX2		// The AVX2 descent is compiled for that target alone and taken only on CPUs that have it
+#include <immintrin.h>
+#endif
+#include "RebuildPool.h"
+#include "MemoryUsage.h"
+#include "RebuildScratch.h"
+using namespace std;
+
+// Amortized weight balance. Every node on the path of an update is checked, and the topmost unbalanced one is rebuilt.
+struct WeightBalance {
+	static const bool checksPath = true;
+	static const bool fixedAlpha = false;
+	static const bool rotates = false;
+
+	static double defaultAlpha() { return 0.32; }
+	static bool validAlpha(double Alpha) { return 0 < Alpha && Alpha < 0.5; }
+	static const char* alphaRange() { return "Alpha must be 0 < Alpha < 0.5"; }
+
+	// Bounds of alpha in adaptive mode. A larger alpha is tighter.
+	static double defaultLoose() { return 0.2; }
+	static double defaultTight() { return 0.32; }
+	static bool validBounds(double Loose, double Tight) { return 0 < Loose && Loose <= Tight && Tight < 0.5; }
+	static const char* boundsRange() { return "Bounds must be 0 < Loose <= Tight < 0.5"; }
+
+	static int depthBound(double alpha, long long size) { return 0; }	// Unused, every node on the path is checked
+	static bool isUnbalanced(double alpha, long long size, long long left, long long right) {
+		double thres = alpha * (size + 1);
+		return left + 1 < thres || right + 1 < thres;
+	}
+
+	// Whether a subtree of side nodes is too light to be a child of a node of size nodes
+	static bool isLight(double alpha, long long size, long long side) { return side + 1 < alpha * (size + 1); }
+	// Smallest side that is not too light for a node of size nodes
+	static long long lightestSide(double alpha, long long size) { return (long long)ceil(alpha * (size + 1)) - 1; }
+	static bool isSingle(long long inner, long long outer) { return true; }	// Unused, only RotationBalance rotates
+};
+
+// WeightBalance with alpha fixed at compile time to Num / Den. The balance checks become integer multiply-compares,
+// which the compiler turns into shifts for a power of two Den, and alpha can neither be passed to the constructor nor adapted.
+template <int Num, int Den>
+struct FixedWeightBalance : WeightBalance {
+	static_assert(0 < Num && 2 * Num < Den, "Alpha must be 0 < Num / Den < 0.5");
+	static const bool fixedAlpha = true;
+
+	static double defaultAlpha() { return double(Num) / Den; }
+	static bool validAlpha(double Alpha) { return Alpha == defaultAlpha(); }
+	static const char* alphaRange() { return "Alpha is fixed to Num / Den"; }
+
+	static bool isUnbalanced(double, long long size, long long left, long long right) {
+		long long thres = Num * (size + 1);
+		return (left + 1) * Den < thres || (right + 1) * Den < thres;
+	}
+	static bool isLight(double, long long size, long long side) { return (side + 1) * Den < Num * (size + 1); }
+	static long long lightestSide(double, long long size) { return (Num * (size + 1) + Den - 1) / Den - 1; }
+};
+
+// Scapegoat balance. Only an insert that ends deeper than the size of the tree allows looks for a scapegoat,
+// the lowest alpha-weight-unbalanced node on its path. Deletes rebuild the whole tree once half of its nodes are gone.
+struct ScapegoatBalance {
+	static const bool checksPath = false;
+	static const bool fixedAlpha = false;
+	static const bool rotates = false;
+
+	static double defaultAlpha() { return 0.5625; }
+	static bool validAlpha(double Alpha) { return 0.5 < Alpha && Alpha < 1; }
+	static const char* alphaRange() { return "Alpha must be 0.5 < Alpha < 1"; }
+
+	// Bounds of alpha in adaptive mode. A smaller alpha is tighter.
+	static double defaultLoose() { return 0.75; }
+	static double defaultTight() { return 0.5625; }
+	static bool validBounds(double Loose, double Tight) { return 0.5 < Tight && Tight <= Loose && Loose < 1; }
+	static const char* boundsRange() { return "Bounds must be 0.5 < Tight <= Loose < 1"; }
+
+	// Deepest an insert into a tree of size nodes may end without looking for a scapegoat.
+	// Only evaluated to fill the table of the sizes at which it steps up, see _depthBound.
+	static int depthBound(double alpha, long long size) { return int(log(size) / log(1 / alpha)) + 1; }
+	static bool isUnbalanced(double alpha, long long size, long long left, long long right) {
+		return left > alpha * size || right > alpha * size;
+	}
+	static bool isLight(double alpha, long long size, long long side) { return false; }	// Unused, only weight balance caches the append path
+	static long long lightestSide(double alpha, long long size) { return 0; }
+	static bool isSingle(long long inner, long long outer) { return true; }
+};
+
+// ScapegoatBalance with alpha fixed at compile time to Num / Den, checked with integer multiply-compares
+template <int Num, int Den>
+struct FixedScapegoatBalance : ScapegoatBalance {
+	static_assert(Den < 2 * Num && Num < Den, "Alpha must be 0.5 < Num / Den < 1");
+	static const bool fixedAlpha = true;
+
+	static double defaultAlpha() { return double(Num) / Den; }
+	static bool validAlpha(double Alpha) { return Alpha == defaultAlpha(); }
+	static const char* alphaRange() { return "Alpha is fixed to Num / Den"; }
+
+	static bool isUnbalanced(double, long long size, long long left, long long right) {
+		long long thres = Num * size;
+		return left * Den > thres || right * Den > thres;
+	}
+};
+
+// Weight balance kept by single and double rotations on the way back up from every update (Adams; Nievergelt and Reingold),
+// for O(log n) worst case updates instead of amortized rebuilds. With weights size + 1, a node is balanced while neither child
+// is more than Delta times as heavy as the other, and a heavy child is rotated up once (single rotation) while its outer child
+// weighs at least 1 / Gamma of its inner one, otherwise twice. <3, 2> is the integer pair Hirai and Yamamoto proved correct.
+// Rebuilds are left to removeRange, which cuts more than rotations can repair, to lazy delete and to rebuild().
+template <int Delta = 3, int Gamma = 2>
+struct RotationBalance : WeightBalance {
+	static const bool fixedAlpha = true;
+	static const bool rotates = true;
+
+	static double defaultAlpha() { return 1.0 / (Delta + 1); }	// Lightest share of a child, as the alpha of WeightBalance
+	static bool validAlpha(double Alpha) { return Alpha == defaultAlpha(); }
+	static const char* alphaRange() { return "Alpha is fixed to 1 / (Delta + 1)"; }
+
+	static bool isUnbalanced(double, long long size, long long left, long long right) {
+		return Delta * (left + 1) < right + 1 || Delta * (right + 1) < left + 1;
+	}
+	// Whether a heavy child of inner and outer grandchildren moves up with a single rotation
+	static bool isSingle(long long inner, long long outer) { return inner + 1 < Gamma * (outer + 1); }
+};
+
+// Rebuilds on the calling thread. Compiles to the plain recursive _getCopy and _buildTree.
+struct SerialRebuild {
+	static const bool parallel = false;
+	size_t stackBytes() { return 0; }
+};
+
+// Rebuilds subtrees of at least Cutoff nodes on a RebuildPool, in up to 2^Depth tasks.
+// Smaller subtrees take the serial path after a single comparison.
+template <int Cutoff = 6000, int Depth = 3>
+struct PoolRebuild {
+	static const bool parallel = true;
+	RebuildPool& pool;
+
+	PoolRebuild(): pool(RebuildPool::shared()) {}
+	PoolRebuild(RebuildPool& Pool): pool(Pool) {}
+
+	bool fork(long long length, int depth) { return length >= Cutoff && depth < Depth; }
+	int parts() { return 1 << Depth; }
+	size_t stackBytes() { return pool.stackBytes(); }
+};
+
+// Aggregate policies. value_type is kept in every node for its subtree, with identity() the identity element of combine,
+// of(key, copies) the value of one node (copies is 0 for a tombstone), and combine associative. Keys are combined in increasing order.
+struct NoAggregate {
+	typedef void value_type;
+};
+
+template <typename T, typename V = T>
+struct SumAggregate {
+	typedef V value_type;
+	static V identity() { return V(); }
+	static V of(const T& key, long long copies) { return V(key) * copies; }
+	static V combine(const V& a, const V& b) { return a + b; }
+};
+
+template <typename T>
+struct MinAggregate {
+	typedef T value_type;
+	static T identity() { return numeric_limits<T>::max(); }
+	static T of(const T& key, long long copies) { return copies > 0 ? key : identity(); }
+	static T combine(const T& a, const T& b) { return b < a ? b : a; }
+};
+
+template <typename T>
+struct MaxAggregate {
+	typedef T value_type;
+	static T identity() { return numeric_limits<T>::lowest(); }
+	static T of(const T& key, long long copies) { return copies > 0 ? key : identity(); }
+	static T combine(const T& a, const T& b) { return a < b ? b : a; }
+};
+
+// Node field holding the aggregate. Empty for NoAggregate, so such nodes do not grow.
+template <typename V>
+struct AggregateField {
+	V agg;
+};
+
+template <>
+struct AggregateField<void> {};
+
+// Node fields of multiset and lazy delete mode. Empty unless the tree is Counted, so the nodes of other trees do not grow :
+// each of their nodes is then one live copy, and its total is its size.
+template <typename SizeT, bool Counted>
+struct CountField {
+	SizeT cnt;		// Number of copies of key. 0 marks a tombstone left by a lazy delete.
+	SizeT total;	// Sum of _weight over the subtree
+
+	CountField(): cnt(1), total(1) {}
+};
+
+template <typename SizeT>
+struct CountField<SizeT, false> {};
+
+template <typename T, typename Compare = less<T>, typename BalancePolicy = WeightBalance,
+	typename RebuildExecutor = SerialRebuild, typename Alloc = allocator<T>, typename Aggregate = NoAggregate, typename SizeT = int, bool Counted = false>
+class BalancedTree {
+	static_assert(is_integral<SizeT>::value && is_signed<SizeT>::value, "SizeT must be a signed integer type");
+
+public:
+	typedef T key_type;
+	typedef Compare key_compare;
+	typedef SizeT size_type;
+
+	BalancedTree() {
+		_init(BalancePolicy::defaultAlpha());
+	}
+
+	BalancedTree(double Alpha, RebuildExecutor Exec = RebuildExecutor(), Compare Comp = Compare(), Alloc A = Alloc())
+		: exec(Exec), comp(Comp), alloc(A), eytz(A) {
+		if (!BalancePolicy::validAlpha(Alpha))
+			throw invalid_argument(BalancePolicy::alphaRange());
+		_init(Alpha);
+	}
+
+	~BalancedTree() {
+		_clear(root);
+	}
+
+	bool search(T v) {
+		if (adaptive)
+			_observe(1, 0);
+		if (frozen)
+			return _searchFrozen(v) != 0;
+		NODE* t = _search(root, v);
+		return t != NULL && _cnt(t) > 0;
+	}
+
+	// Stores search(keys[i]) in results[i] for every i.
+	// Lookups are interleaved so that their cache misses overlap, and sorted batches share the top of their descent.
+	void searchBatch(const vector<T>& keys, vector<bool>& results) {
+		if (adaptive)
+			_observe(keys.size(), 0);
+		results.assign(keys.size(), false);
+		if (frozen) {
+			for (size_t i = 0; i < keys.size(); i++)
+				results[i] = _searchFrozen(keys[i]) != 0;
+			return;
+		}
+		if (root == NULL)
+			return;
+		if (is_sorted(keys.begin(), keys.end(), comp))
+			_searchSorted(keys, results);
+		else
+			_searchInterleaved(keys, results);
+	}
+
+	// Throws length_error once the tree holds numeric_limits<SizeT>::max() keys, counted with every copy, or nodes, counted with
+	// the tombstones of lazy deletes, which are dropped first, or once a key holds that many copies
+	bool insert(T v) {
+		_checkThawed();
+		// The root's size and total lag behind by pending while the append finger is active
+		if (_size(root) >= numeric_limits<SizeT>::max() - pending && dead > 0) {
+			_flushFinger();
+			_rebuild(root);
+			max_size = root ? root->size : 0;
+		}
+		if (_total(root) >= numeric_limits<SizeT>::max() - pending || _size(root) >= numeric_limits<SizeT>::max() - pending)
+			throw length_error("The tree is full, use a wider SizeT");
+		if (adaptive)
+			_observe(0, 1);
+		if (!spine.empty() && comp(spine.back()->key, v)) {
+			_append(v);
+			return true;
+		}
+		_flushFinger();
+
+		// The append finger relies on the weight balance rule, so only WeightBalance trees track appends
+		bool appending = BalancePolicy::checksPath && !BalancePolicy::rotates && (root == NULL || comp(_getMax()->key, v));
+		bool check = BalancePolicy::checksPath;
+		NODE** rebuildLoc = NULL;
+		int result = _insert(root, v, 0, check, rebuildLoc);
+		if (rebuildLoc)
+			_rebuild(*rebuildLoc);
+
+		if (appending) {
+			maxNode = _getRightMost(root);
+			if (++appendRun >= APPEND_RUN)
+				_buildFinger();
+		}
+		else
+			appendRun = 0;
+		return result != 0;
+	}
+
+	bool remove(T v) {
+		_checkThawed();
+		if (adaptive)
+			_observe(0, 1);
+		if (lazyDelete)
+			return _removeLazy(v);
+		_flushFinger();
+		appendRun = 0;
+		if (maxNode && !comp(v, maxNode->key))
+			maxNode = NULL;
+		NODE** rebuildLoc = NULL;
+		int result = _delete(root, v, rebuildLoc);
+		if (rebuildLoc)
+			_rebuildAt(rebuildLoc);
+		_rebuildIfShrunk();
+		return result != 0;
+	}
+
+	// Removes every key k with lo <= k <= hi and returns how many keys were removed, counted the same way as size().
+	// The keys in range are cut off along the paths to lo and hi, and the fixed sizes are checked on those paths only,
+	// so the whole call rebuilds at most one subtree. A parallel tree frees large cut subtrees on its pool.
+	SizeT removeRange(T lo, T hi) {
+		_checkThawed();
+		if (adaptive)
+			_observe(0, 1);
+		if (comp(hi, lo))
+			return 0;
+		_flushFinger();
+		appendRun = 0;
+		if (maxNode && !comp(maxNode->key, lo))
+			maxNode = NULL;
+		SizeT before = _total(root);
+		vector<NODE*> cut;
+		NODE** rebuildLoc = NULL;
+		_cutRange(root, lo, hi, cut, rebuildLoc);
+		SizeT removed = before - _total(root);
+		dead -= _freeCut(cut, integral_constant<bool, RebuildExecutor::parallel && is_same<NodeAlloc, allocator<NODE> >::value>());
+		if (rebuildLoc)
+			_rebuild(*rebuildLoc);
+		if (!BalancePolicy::checksPath && root && root->size <= max_size / 2) {
+			_rebuild(root);
+			max_size = root->size;
+		}
+		if (root == NULL)
+			max_size = 0;
+		return removed;
+	}
+
+	// Aggregate of the keys k with lo <= k <= hi in O(log n), from the aggregates the nodes keep of their subtrees
+	typename Aggregate::value_type rangeAggregate(T lo, T hi) {
+		static_assert(Aggregated::value, "rangeAggregate needs an Aggregate policy other than NoAggregate");
+		_checkThawed();
+		_flushFinger();
+		NODE* t = root;
+		while (t != NULL && (comp(t->key, lo) || comp(hi, t->key)))	// Find the node where the paths to lo and hi part
+			t = comp(t->key, lo) ? t->right : t->left;
+		if (t == NULL || comp(hi, lo))
+			return Aggregate::identity();
+
+		// Nodes on the path to lo that are in range bring their right subtree along, and precede what was found above them.
+		// Likewise on the path to hi, with left subtrees and following what was found above.
+		typename Aggregate::value_type left = Aggregate::identity(), right = Aggregate::identity();
+		for (NODE* u = t->left; u != NULL; ) {
+			if (comp(u->key, lo))
+				u = u->right;
+			else {
+				left = Aggregate::combine(Aggregate::combine(_self(u), _agg(u->right)), left);
+				u = u->left;
+			}
+		}
+		for (NODE* u = t->right; u != NULL; ) {
+			if (comp(hi, u->key))
+				u = u->left;
+			else {
+				right = Aggregate::combine(right, Aggregate::combine(_agg(u->left), _self(u)));
+				u = u->right;
+			}
+		}
+		return Aggregate::combine(Aggregate::combine(left, _self(t)), right);
+	}
+
+	// Number of copies of v (0 or 1 unless in multiset mode)
+	SizeT count(T v) {
+		if (adaptive)
+			_observe(1, 0);
+		if (frozen) {
+			size_t k = _searchFrozen(v);
+			return k == 0 ? 0 : isMulti ? eytzCnt[k] : 1;
+		}
+		NODE* t = _search(root, v);
+		return t ? _cnt(t) : 0;
+	}
+
+	// Number of keys, counting either distinct keys or all copies (see setMultiset)
+	SizeT size() {
+		if (frozen)
+			return frozenTotal;
+		_flushFinger();
+		return _total(root);
+	}
+
+	// Number of keys less than v, counted the same way as size()
+	SizeT rank(T v) {
+		_checkThawed();
+		if (adaptive)
+			_observe(1, 0);
+		_flushFinger();
+		SizeT r = 0;
+		NODE* t = root;
+		while (t != NULL) {
+			if (comp(v, t->key))
+				t = t->left;
+			else {
+				r += _total(t->left);
+				if (!comp(t->key, v))
+					break;
+				r += _weight(t);
+				t = t->right;
+			}
+		}
+		return r;
+	}
+
+	// Calls f(key) for every key. On a parallel tree, the keys are split by subtree sizes into exec.parts() rank ranges of equal length,
+	// each visited in increasing order by its own pool task, so f must be safe to call from several threads at once.
+	// A serial tree visits all keys in increasing order on the calling thread. In multiset mode, f sees each distinct key once.
+	template <typename F>
+	void parallel_for_each(F f) {
+		_checkThawed();
+		_flushFinger();
+		_forRanks(0, _size(root) - 1, f, Parallel());
+	}
+
+	// parallel_for_each restricted to the keys k with lo <= k <= hi
+	template <typename F>
+	void parallel_for_each(T lo, T hi, F f) {
+		_checkThawed();
+		_flushFinger();
+		if (!comp(hi, lo))
+			_forRanks(_nodeRank(lo, false), _nodeRank(hi, true) - 1, f, Parallel());
+	}
+
+	// Returns identity combined with map(key) for every key, in increasing order of the keys : each rank range of parallel_for_each
+	// is folded from identity by its own task, and the results are combined from left to right.
+	// combine therefore has to be associative, but need not be commutative, and identity has to be its identity element.
+	template <typename R, typename Map, typename Combine>
+	R parallel_reduce(R identity, Map map, Combine combine) {
+		_checkThawed();
+		_flushFinger();
+		return _reduceRanks(0, _size(root) - 1, identity, map, combine, Parallel());
+	}
+
+	// parallel_reduce restricted to the keys k with lo <= k <= hi
+	template <typename R, typename Map, typename Combine>
+	R parallel_reduce(T lo, T hi, R identity, Map map, Combine combine) {
+		_checkThawed();
+		_flushFinger();
+		if (comp(hi, lo))
+			return identity;
+		return _reduceRanks(_nodeRank(lo, false), _nodeRank(hi, true) - 1, identity, map, combine, Parallel());
+	}
+
+	// In multiset mode, inserting an existing key increments its count instead of failing,
+	// and remove only unlinks a node once its count drops to 0. Repeated keys add no nodes and trigger no rebuilds.
+	// CountCopies selects whether size() and rank() count every copy or only distinct keys. Only Counted trees accept it.
+	void setMultiset(bool Multi, bool CountCopies = true) {
+		if (Multi && !Counted)
+			throw logic_error("Multiset mode needs a Counted tree");
+		if (root || frozen)
+			throw logic_error("Multiset mode can only be changed while the tree is empty");
+		isMulti = Multi;
+		countCopies = Multi && CountCopies;
+	}
+
+	// In lazy delete mode, remove only marks the node as a tombstone and leaves the shape of the tree unchanged.
+	// Tombstones are dropped by the next rebuild of the whole tree, which is forced once more than MaxDead of all nodes are tombstones.
+	// Only Counted trees accept it.
+	void setLazyDelete(bool Lazy, double MaxDead = 0.25) {
+		if ((MaxDead <= 0) || (1 < MaxDead))
+			throw invalid_argument("MaxDead must be 0 < MaxDead <= 1");
+		if (Lazy && !Counted)
+			throw logic_error("Lazy delete mode needs a Counted tree");
+		_checkThawed();
+		lazyDelete = Lazy;
+		maxDead = MaxDead;
+		if (!lazyDelete && dead > 0) {
+			_flushFinger();
+			_rebuild(root);
+			max_size = root ? root->size : 0;
+		}
+	}
+
+	// In local delete mode, remove checks the nodes on its path against Alpha and rebuilds the topmost one it tipped out of balance,
+	// so a scapegoat tree is kept balanced by rebuilds of small subtrees. The whole tree is then rebuilt only once it has shrunk
+	// to Fallback of its largest size since the last such rebuild, instead of to half of it. removeRange is unaffected.
+	// Alpha is a scapegoat alpha even where the policy fixes its own, which it need not match.
+	// Weight balanced trees always rebalance their deletes locally, so turning the mode on for them throws logic_error.
+	void setLocalDelete(bool Local, double Alpha = ScapegoatBalance::defaultLoose(), double Fallback = 0.25) {
+		if (Local && BalancePolicy::checksPath)
+			throw logic_error("Local delete mode needs a scapegoat balance policy");
+		if (!ScapegoatBalance::validAlpha(Alpha))
+			throw invalid_argument(ScapegoatBalance::alphaRange());
+		if ((Fallback <= 0) || (0.5 < Fallback))
+			throw invalid_argument("Fallback must be 0 < Fallback <= 0.5");
+		localDelete = Local;
+		deleteAlpha = Alpha;
+		shrinkLimit = Local ? Fallback : 0.5;
+	}
+
+	// In adaptive mode, alpha follows the mix of operations. After every window of max(ADAPT_WINDOW, number of nodes) operations,
+	// it is moved between Loose and Tight in proportion to the share of reads: read-heavy phases get a shallower tree,
+	// write-heavy phases fewer rebuilds. Alpha is not tightened while rebuilds already cost more than the descents of the updates,
+	// and tightening rebuilds the whole tree once, which the length of the window pays for.
+	void setAdaptive(bool Adaptive, double Loose = BalancePolicy::defaultLoose(), double Tight = BalancePolicy::defaultTight()) {
+		if (Adaptive && BalancePolicy::fixedAlpha)
+			throw logic_error("Alpha is fixed by the balance policy");
+		if (!BalancePolicy::validBounds(Loose, Tight))
+			throw invalid_argument(BalancePolicy::boundsRange());
+		adaptive = Adaptive;
+		alphaLoose = Loose;
+		alphaTight = Tight;
+		reads = writes = rebuilt = 0;
+	}
+
+	double getAlpha() {
+		return alpha;
+	}
+
+	// Bytes used by the tree. The nodes are counted with the overhead malloc adds to each of them,
+	// unless the tree was given another allocator. While the tree is frozen, nodes is the size of its key array. See MemoryUsage.h.
+	MemoryUsage memoryUsage() {
+		MemoryUsage m;
+		size_t nodes = _size(root) + pending;	// The root's size lags behind by pending while the append finger is active
+		m.nodes = nodes * sizeof(NODE) + eytz.capacity() * sizeof(T) + eytzCnt.capacity() * sizeof(SizeT);
+		if (is_same<NodeAlloc, allocator<NODE> >::value)
+			m.overhead = nodes * MemoryUsage::mallocOverhead(sizeof(NODE));
+		m.overhead += sizeof(*this) + spine.capacity() * sizeof(NODE*) + spineMin.capacity() * sizeof(SizeT);
+		m.scratch = scratchArr.capacity();
+		m.scratchPeak = scratchPeak;
+		m.stacks = exec.stackBytes();
+		return m;
+	}
+
+	// Largest array a rebuild may allocate, in bytes, or 0 for no limit. A rebuild that would need a larger one
+	// relinks the nodes in place on the calling thread instead : slower and never parallel, but it allocates nothing.
+	// freeze, thaw, dump and assign, and so TreeLog checkpoints, keep to the same limit the same way.
+	void setScratchLimit(size_t Bytes) {
+		scratchLimit = Bytes;
+		if (scratchLimit > 0 && scratchArr.capacity() > scratchLimit)
+			scratchArr.release();
+	}
+
+	// Frees the buffer kept for rebuilds, e.g. under memory pressure. The next rebuild allocates a new one.
+	void releaseScratch() {
+		scratchArr.release();
+	}
+
+	void rebuild() {
+		_checkThawed();
+		_flushFinger();
+		_rebuild(root);
+	}
+
+	// Moves the keys into an array in Eytzinger (breadth-first) order and frees every node, for long read-only phases.
+	// Until thaw(), search, searchBatch, count and size use the array, which takes a fraction of the memory of the nodes
+	// and is searched without branches. Every other operation throws logic_error.
+	void freeze() {
+		if (frozen)
+			return;
+		_flushFinger();
+		SizeT length = _size(root);
+		frozenTotal = _total(root);
+		NODE** nodeArr = NULL;
+		NODE* head = NULL;
+		SizeT live = 0;
+		if (_overScratchLimit(length))
+			live = _toVine(root, head, true);		// Tombstones are freed on the way
+		else {
+			nodeArr = _scratch(length);
+			if (root)
+				_flatten(root, nodeArr, Parallel());
+			for (SizeT i = 0; i < length; i++)
+				if (_cnt(nodeArr[i]) > 0)
+					nodeArr[live++] = nodeArr[i];
+		}
+
+		// One line of padding, so that eytzBase can start on a cache line and the children of a node share one
+		size_t pad = (sizeof(T) < CACHE_LINE && CACHE_LINE % sizeof(T) == 0) ? CACHE_LINE / sizeof(T) : 0;
+		eytz.assign(live + 1 + pad, T());
+		eytzBase = eytz.data();
+		while (pad > 0 && (size_t)eytzBase % CACHE_LINE != 0 && eytzBase < eytz.data() + pad)
+			eytzBase++;
+		if (isMulti)
+			eytzCnt.assign(live + 1, 0);
+		frozenSize = live;
+		if (nodeArr) {
+			_toEytzinger(nodeArr, 0, 1);
+			_clear(root);
+		}
+		else {
+			NODE* cur = head;
+			_vineToEytzinger(cur, 1);
+			_freeVine(head);
+			root = NULL;
+		}
+		max_size = 0;
+		maxNode = NULL;
+		appendRun = 0;
+		dead = 0;
+		frozen = true;
+	}
+
+	// Rebuilds the nodes from the array and makes the tree writable again
+	void thaw() {
+		if (!frozen)
+			return;
+		if (_overScratchLimit(frozenSize)) {
+			NODE* head = NULL;
+			NODE** tail = &head;
+			_eytzingerToVine(tail, 1);
+			*tail = NULL;
+			root = _buildVine(head, frozenSize, false);
+		}
+		else {
+			NODE** nodeArr = _scratch(frozenSize);
+			_fromEytzinger(nodeArr, 0, 1);
+			root = _build(nodeArr, 0, frozenSize - 1, Parallel());
+		}
+		max_size = frozenSize;
+		_dropFrozen();
+	}
+
+	bool isFrozen() {
+		return frozen;
+	}
+
+	// Stores the keys in increasing order in keys and the number of copies of each in counts, as a checkpoint of the tree.
+	// The nodes are gathered by the same (on a parallel tree, parallel) flatten as a rebuild.
+	void dump(vector<T>& keys, vector<SizeT>& counts) {
+		_checkThawed();
+		_flushFinger();
+		SizeT length = _size(root);
+		keys.clear();
+		counts.clear();
+		keys.reserve(length - dead);
+		counts.reserve(length - dead);
+		if (_overScratchLimit(length)) {
+			_dumpNodes(root, keys, counts);
+			return;
+		}
+		NODE** nodeArr = _scratch(length);
+		if (root)
+			_flatten(root, nodeArr, Parallel());
+		for (SizeT i = 0; i < length; i++)
+			if (_cnt(nodeArr[i]) > 0) {
+				keys.push_back(nodeArr[i]->key);
+				counts.push_back(_cnt(nodeArr[i]));
+			}
+	}
+
+	// Replaces the contents of the tree by keys, which have to be strictly increasing, with counts[i] copies of keys[i].
+	// The nodes are linked into a perfectly balanced tree at once, as a rebuild would, instead of being inserted one by one.
+	// Counts other than 1 need multiset mode.
+	void assign(const vector<T>& keys, const vector<SizeT>& counts) {
+		if (keys.size() != counts.size())
+			throw invalid_argument("keys and counts must have the same length");
+		if (keys.size() >= (size_t)numeric_limits<SizeT>::max())
+			throw length_error("Too many keys for SizeT");
+		SizeT total = 0;
+		for (size_t i = 0; i < keys.size(); i++) {
+			if (i > 0 && !comp(keys[i - 1], keys[i]))
+				throw invalid_argument("keys must be strictly increasing");
+			if (counts[i] <= 0 || (counts[i] > 1 && !isMulti))
+				throw invalid_argument("counts must be positive, and 1 unless in multiset mode");
+			if (counts[i] >= numeric_limits<SizeT>::max() - total)
+				throw length_error("Too many keys for SizeT");
+			total += counts[i];
+		}
+		clear();
+		SizeT length = (SizeT)keys.size();
+		if (_overScratchLimit(length)) {
+			NODE* head = NULL;
+			NODE** tail = &head;
+			for (SizeT i = 0; i < length; i++) {
+				*tail = _newNode(keys[i]);
+				_setCnt(*tail, counts[i]);
+				tail = &(*tail)->right;
+			}
+			*tail = NULL;
+			root = _buildVine(head, length, false);
+			max_size = length;
+			return;
+		}
+		NODE** nodeArr = _scratch(length);
+		for (SizeT i = 0; i < length; i++) {
+			nodeArr[i] = _newNode(keys[i]);
+			_setCnt(nodeArr[i], counts[i]);
+		}
+		root = _build(nodeArr, 0, length - 1, Parallel());
+		max_size = length;
+	}
+
+	bool isMultiset() {
+		return isMulti;
+	}
+
+	key_compare key_comp() {
+		return comp;
+	}
+
+	void clear() {
+		_dropFrozen();
+		_flushFinger();
+		_clear(root);
+		max_size = 0;
+		maxNode = NULL;
+		appendRun = 0;
+		dead = 0;
+	}
+
+private:
+	struct NODE : AggregateField<typename Aggregate::value_type>, CountField<SizeT, Counted> {
+		NODE* left, * right;
+		T key;
+		SizeT size;		// Number of nodes in the subtree. Drives balancing and rebuilds.
+
+		NODE(T v) {
+			left = right = NULL;
+			key = v;
+			size = 1;
+		}
+	};
+	typedef typename allocator_traits<Alloc>::template rebind_alloc<NODE> NodeAlloc;
+	typedef allocator_traits<NodeAlloc> NodeTraits;
+	typedef integral_constant<bool, RebuildExecutor::parallel> Parallel;
+	typedef integral_constant<bool, !is_void<typename Aggregate::value_type>::value> Aggregated;
+	typedef integral_constant<bool, Counted> CountedNodes;
+
+	NODE* root;
+	SizeT max_size;	// Largest number of nodes since the last rebuild of the whole tree. Only used by ScapegoatBalance.
+	bool localDelete;	// ScapegoatBalance only. Whether deletes check their path for weight balance, see setLocalDelete.
+	double deleteAlpha;	// ScapegoatBalance only. Alpha those checks use.
+	double shrinkLimit;	// Fraction of max_size at or below which a delete rebuilds the whole tree of a scapegoat tree
+	double alpha;
+	// ScapegoatBalance only. depthTable[i] is the smallest size whose depth bound is i + 1, and depthLevel the entry of the current size.
+	vector<SizeT> depthTable;
+	int depthLevel;
+	RebuildExecutor exec;
+	Compare comp;
+	NodeAlloc alloc;
+	bool isMulti, countCopies;
+	bool lazyDelete;
+	double maxDead;
+	SizeT dead;	// Number of tombstones, i.e. nodes whose cnt is 0
+
+	// Adaptive mode. reads and writes count the operations of the current window, rebuilt the nodes its rebuilds copied.
+	bool adaptive;
+	double alphaLoose, alphaTight;
+	long long reads, writes, rebuilt;
+
+	// Append finger. After APPEND_RUN inserts in a row that each exceed every key in the tree,
+	// the rightmost path is cached so later appends link the new node directly.
+	// The size and total fields of spine nodes then lag behind by pending, which _flushFinger settles.
+	NODE* maxNode;		// Node with the largest key, or NULL if unknown
+	int appendRun;		// Number of consecutive appends
+	vector<NODE*> spine;	// root, root->right, root->right->right, ... while the finger is active
+	vector<SizeT> spineMin;	// spineMin[i] : smallest value of pending at which one of spine[0..i] becomes unbalanced
+	SizeT pending;
+
+	// Rebuild scratch memory. scratchArr holds the array of every rebuild, scratchPeak is the most bytes it has held.
+	RebuildScratch scratchArr;
+	size_t scratchPeak, scratchLimit;
+
+	// Frozen mode. eytzBase[1..frozenSize] holds the keys in Eytzinger order : the children of eytzBase[k] are eytzBase[2k] and eytzBase[2k + 1].
+	// eytzBase points into eytz, past the padding that aligns it. eytzCnt holds the counts in multiset mode.
+	typedef integral_constant<bool, is_same<T, int>::value && is_same<Compare, less<int> >::value> IntKeys;
+	bool frozen;
+	vector<T, Alloc> eytz;
+	T* eytzBase;
+	vector<SizeT> eytzCnt;
+	SizeT frozenSize, frozenTotal;
+
+	/* Auxillary function used in the constructors */
+	void _init(double Alpha) {
+		root = NULL;
+		max_size = 0;
+		localDelete = false;
+		deleteAlpha = ScapegoatBalance::defaultLoose();
+		shrinkLimit = 0.5;
+		alpha = Alpha;
+		_buildDepthTable();
+		isMulti = false;
+		countCopies = false;
+		lazyDelete = false;
+		maxDead = 0.25;
+		dead = 0;
+		adaptive = false;
+		alphaLoose = alphaTight = alpha;
+		reads = writes = rebuilt = 0;
+		maxNode = NULL;
+		appendRun = 0;
+		pending = 0;
+		scratchPeak = scratchLimit = 0;
+		frozen = false;
+		eytzBase = NULL;
+		frozenSize = frozenTotal = 0;
+	}
+
+	/* Auxillary function used by the operations that need the nodes */
+	void _checkThawed() {
+		if (frozen)
+			throw logic_error("The tree is frozen, call thaw() first");
+	}
+
+	/* Auxillary function used in thaw and clear */
+	void _dropFrozen() {
+		vector<T, Alloc>(eytz.get_allocator()).swap(eytz);
+		vector<SizeT>().swap(eytzCnt);
+		eytzBase = NULL;
+		frozenSize = frozenTotal = 0;
+		frozen = false;
+	}
+
+	NODE* _newNode(T v) {
+		NODE* t = NodeTraits::allocate(alloc, 1);
+		NodeTraits::construct(alloc, t, v);
+		_pull(t);
+		return t;
+	}
+
+	/* Recomputes the aggregate of t from its children. Called wherever size or total of a node may have changed,
+	   and compiles to nothing for NoAggregate. */
+	void _pull(NODE* t) {
+		_pull(t, Aggregated());
+	}
+
+	void _pull(NODE* t, false_type) {}
+
+	void _pull(NODE* t, true_type) {
+		t->agg = Aggregate::combine(Aggregate::combine(_agg(t->left), _self(t)), _agg(t->right));
+	}
+
+	typename Aggregate::value_type _agg(NODE* t) {
+		return t ? t->agg : Aggregate::identity();
+	}
+
+	typename Aggregate::value_type _self(NODE* t) {
+		return Aggregate::of(t->key, _cnt(t));
+	}
+
+	void _freeNode(NODE* t) {
+		NodeTraits::destroy(alloc, t);
+		NodeTraits::deallocate(alloc, t, 1);
+	}
+
+	SizeT _weight(NODE* t) {
+		return countCopies ? _cnt(t) : (_cnt(t) > 0);
+	}
+
+	SizeT _total(NODE* t) {
+		return t ? _total(t, CountedNodes()) : 0;
+	}
+
+	SizeT _total(NODE* t, false_type) {
+		return t->size;
+	}
+
+	SizeT _total(NODE* t, true_type) {
+		return t->total;
+	}
+
+	void _setTotal(NODE* t, SizeT total) {
+		_setTotal(t, total, CountedNodes());
+	}
+
+	void _setTotal(NODE* t, SizeT total, false_type) {}
+
+	void _setTotal(NODE* t, SizeT total, true_type) {
+		t->total = total;
+	}
+
+	void _addTotal(NODE* t, SizeT d) {
+		_setTotal(t, _total(t) + d);
+	}
+
+	SizeT _cnt(NODE* t) {
+		return _cnt(t, CountedNodes());
+	}
+
+	SizeT _cnt(NODE* t, false_type) {
+		return 1;
+	}
+
+	SizeT _cnt(NODE* t, true_type) {
+		return t->cnt;
+	}
+
+	void _setCnt(NODE* t, SizeT cnt) {
+		_setCnt(t, cnt, CountedNodes());
+	}
+
+	void _setCnt(NODE* t, SizeT cnt, false_type) {}
+
+	void _setCnt(NODE* t, SizeT cnt, true_type) {
+		t->cnt = cnt;
+	}
+
+	SizeT _size(NODE* t) {
+		return t ? t->size : 0;
+	}
+
+	bool _isUnbalanced(NODE* t) {
+		return BalancePolicy::isUnbalanced(alpha, t->size, _size(t->left), _size(t->right));
+	}
+
+	/* Auxillary function used in _delete, after the left (fromLeft) or right subtree of t lost a node. Whether t has to be rebuilt :
+	   for WeightBalance whenever it is unbalanced, for ScapegoatBalance in local delete mode only if it was this delete that
+	   tipped it over deleteAlpha, so the imbalance inserts leave for the scapegoat checks is never rebuilt by a delete */
+	bool _isUnbalancedDelete(NODE* t, bool fromLeft) {
+		if (BalancePolicy::checksPath)
+			return _isUnbalanced(t);
+		if (!localDelete)
+			return false;
+		SizeT l, r;	// The sibling's size follows from t's, so the check reads no node off the path
+		if (fromLeft) {
+			l = _size(t->left);
+			r = t->size - 1 - l;
+		}
+		else {
+			r = _size(t->right);
+			l = t->size - 1 - r;
+		}
+		// Not BalancePolicy's check, which a fixed alpha policy evaluates with its own alpha
+		return ScapegoatBalance::isUnbalanced(deleteAlpha, t->size, l, r) &&
+			!ScapegoatBalance::isUnbalanced(deleteAlpha, t->size + 1, l + fromLeft, r + !fromLeft);
+	}
+
+	/* Auxillary function used in remove. Rebuilds the subtree at loc, which counts as a rebuild of the whole tree if loc is the root */
+	void _rebuildAt(NODE** loc) {
+		_rebuild(*loc);
+		if (loc == &root && root)
+			max_size = root->size;
+	}
+
+	/* Auxillary function used in remove. Rebuilds a scapegoat tree that has shrunk to shrinkLimit of max_size */
+	void _rebuildIfShrunk() {
+		if (!BalancePolicy::checksPath && root && root->size <= shrinkLimit * max_size) {
+			_rebuild(root);
+			max_size = root->size;
+		}
+	}
+
+	/* Auxillary function used in insert */
+	NODE* _getMax() {
+		if (maxNode == NULL)
+			maxNode = _getRightMost(root);
+		return maxNode;
+	}
+
+	/* Auxillary function used in _delete and _getMax */
+	NODE* _getRightMost(NODE* t) {
+		while (t->right != NULL)
+			t = t->right;
+		return t;
+	}
+
+	/* Auxillary function used in the append path. Returns the value of pending at which spine node t becomes unbalanced.
+	   Appends only grow t's right subtree, so only its left side can become too light. */
+	SizeT _appendLimit(NODE* t) {
+		long long l = _size(t->left);
+		long long s = (long long)((l + 1) / alpha);		// Smallest real size s of t at which a left subtree of l nodes is too light
+		while (!BalancePolicy::isLight(alpha, s, l))
+			s++;
+		while (s > 0 && BalancePolicy::isLight(alpha, s - 1, l))
+			s--;
+		return (SizeT)min(s - t->size, (long long)numeric_limits<SizeT>::max());	// Beyond what SizeT holds, the tree fills up first
+	}
+
+	/* Auxillary function used in the append path */
+	void _pushSpine(NODE* t) {
+		SizeT limit = _appendLimit(t);
+		if (!spineMin.empty() && spineMin.back() < limit)
+			limit = spineMin.back();
+		spine.push_back(t);
+		spineMin.push_back(limit);
+	}
+
+	void _buildFinger() {
+		for (NODE* t = root; t != NULL; t = t->right)
+			_pushSpine(t);
+	}
+
+	// Adds the pending appends to the spine nodes, recomputes their aggregates bottom-up, and drops the finger
+	void _flushFinger() {
+		for (size_t i = 0; i < spine.size(); i++) {
+			spine[i]->size += pending;
+			_addTotal(spine[i], pending);
+		}
+		if (Aggregated::value)
+			for (size_t i = spine.size(); i-- > 0; )
+				_pull(spine[i]);
+		spine.clear();
+		spineMin.clear();
+		pending = 0;
+	}
+
+	/* Links v as the right child of the rightmost node, without a descent or a balance check per level.
+	   Once some spine nodes become unbalanced, the topmost of them is rebuilt and the spine below it is recomputed. */
+	void _append(T v) {
+		NODE* t = _newNode(v);
+		spine.back()->right = t;
+		maxNode = t;
+		pending++;
+		t->size = 1 - pending;
+		_setTotal(t, 1 - pending);
+		_pushSpine(t);
+		if (spineMin.back() > pending)
+			return;
+
+		// spineMin is non-increasing, so this finds the topmost unbalanced spine node
+		size_t i = partition_point(spineMin.begin(), spineMin.end(), [this](SizeT limit) { return limit > pending; }) - spineMin.begin();
+		for (size_t j = i; j < spine.size(); j++) {
+			spine[j]->size += pending;
+			_addTotal(spine[j], pending);
+		}
+		NODE*& loc = (i == 0) ? root : spine[i - 1]->right;
+		_rebuild(loc, true);
+		spine.resize(i);
+		spineMin.resize(i);
+		for (t = loc; t != NULL; t = t->right) {
+			t->size -= pending;
+			_addTotal(t, -pending);
+			_pushSpine(t);
+		}
+	}
+
+	/* Evaluates both comparisons before branching. The only branch left, on a match, is almost never taken,
+	   and the choice of child compiles to a conditional move instead of a branch that mispredicts half of the time. */
+	NODE* _search(NODE* t, T v) {
+		while (t != NULL) {
+			bool less = comp(v, t->key), greater = comp(t->key, v);
+			if (!(less | greater))
+				return t;
+			t = less ? t->left : t->right;
+		}
+		return NULL;
+	}
+
+	/* Auxillary function used in freeze. Stores nodeArr[i..] in key order into the subtree of eytzBase[k] and returns the next i */
+	SizeT _toEytzinger(NODE** nodeArr, SizeT i, size_t k) {
+		if (k > (size_t)frozenSize)
+			return i;
+		i = _toEytzinger(nodeArr, i, 2 * k);
+		eytzBase[k] = nodeArr[i]->key;
+		if (isMulti)
+			eytzCnt[k] = _cnt(nodeArr[i]);
+		return _toEytzinger(nodeArr, i + 1, 2 * k + 1);
+	}
+
+	/* Auxillary function used in thaw. Allocates the nodes of the subtree of eytzBase[k] in key order into nodeArr[i..] and returns the next i */
+	SizeT _fromEytzinger(NODE** nodeArr, SizeT i, size_t k) {
+		if (k > (size_t)frozenSize)
+			return i;
+		i = _fromEytzinger(nodeArr, i, 2 * k);
+		nodeArr[i] = _newNode(eytzBase[k]);
+		if (isMulti)
+			_setCnt(nodeArr[i], eytzCnt[k]);
+		return _fromEytzinger(nodeArr, i + 1, 2 * k + 1);
+	}
+
+	/* Auxillary function used in freeze above the scratch limit. Stores the list at head in key order into the subtree of eytzBase[k] and advances head */
+	void _vineToEytzinger(NODE*& head, size_t k) {
+		if (k > (size_t)frozenSize)
+			return;
+		_vineToEytzinger(head, 2 * k);
+		eytzBase[k] = head->key;
+		if (isMulti)
+			eytzCnt[k] = _cnt(head);
+		head = head->right;
+		_vineToEytzinger(head, 2 * k + 1);
+	}
+
+	/* Auxillary function used in thaw above the scratch limit. Allocates the nodes of the subtree of eytzBase[k] in key order onto the list at tail */
+	void _eytzingerToVine(NODE**& tail, size_t k) {
+		if (k > (size_t)frozenSize)
+			return;
+		_eytzingerToVine(tail, 2 * k);
+		*tail = _newNode(eytzBase[k]);
+		if (isMulti)
+			_setCnt(*tail, eytzCnt[k]);
+		tail = &(*tail)->right;
+		_eytzingerToVine(tail, 2 * k + 1);
+	}
+
+	/* Auxillary function used in dump above the scratch limit. Appends the live keys of t and their counts in key order */
+	void _dumpNodes(NODE* t, vector<T>& keys, vector<SizeT>& counts) {
+		if (t == NULL)
+			return;
+		_dumpNodes(t->left, keys, counts);
+		if (_cnt(t) > 0) {
+			keys.push_back(t->key);
+			counts.push_back(_cnt(t));
+		}
+		_dumpNodes(t->right, keys, counts);
+	}
+
+	/* Returns the index of v in eytzBase, or 0 if it is not there.
+	   The loop always runs for the height of the array, and each step is k = 2k or 2k + 1 by the outcome of one comparison,
+	   so it compiles to a conditional add with no branch to mispredict. The cache line holding the descendants
+	   four levels down (for int keys) is prefetched on the way. After the loop, the trailing 1 bits of k are the steps
+	   taken right since the last step left, which leads to the smallest key not less than v. */
+	size_t _searchFrozen(const T& v) {
+		const T* a = eytzBase;
+		const size_t ahead = sizeof(T) < CACHE_LINE ? CACHE_LINE / sizeof(T) : 1;
+		size_t k = _descendFrozen(1, v, IntKeys()), n = frozenSize;
+		while (k <= n) {
+			__builtin_prefetch(a + k * ahead);
+			k = 2 * k + comp(a[k], v);
+		}
+		k >>= __builtin_ffsll(~(long long)k);
+		return (k != 0 && !comp(v, a[k])) ? k : 0;
+	}
+
+	/* Auxillary function used in _searchFrozen for int keys compared by less<int>. Takes the AVX2 descent where the CPU supports it
+	   and the array is small enough to be cached, and returns k where the scalar loop has to take over. */
+	size_t _descendFrozen(size_t k, const T& v, true_type) {
+#ifdef FROZEN_AVX2
+		static const bool avx2 = __builtin_cpu_supports("avx2");
+		if (avx2 && frozenSize <= FROZEN_SIMD_MAX)
+			return _descendAvx2(k, v);
+#endif
+		return k;
+	}
+
+#ifdef FROZEN_AVX2
+	/* Auxillary function used in _descendFrozen. Descends four levels per step : the path from k to its descendant four levels down
+	   is the number of the 15 keys in between that are less than v, which takes one compare per level instead of four dependent loads. */
+	__attribute__((target("avx2")))
+	size_t _descendAvx2(size_t k, const T& v) {
+		const int* a = (const int*)eytzBase;
+		__m128i v4 = _mm_set1_epi32(v);
+		__m256i v8 = _mm256_set1_epi32(v);
+		while (8 * k + 7 <= (size_t)frozenSize) {
+			__builtin_prefetch(a + 16 * k);	// Holds the next k
+			int r = (a[k] < v) + (a[2 * k] < v) + (a[2 * k + 1] < v);
+			r += __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(v4, _mm_loadu_si128((const __m128i*)(a + 4 * k))))));
+			r += __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(v8, _mm256_loadu_si256((const __m256i*)(a + 8 * k))))));
+			k = 16 * k + r;
+		}
+		return k;
+	}
+#endif
+
+	size_t _descendFrozen(size_t k, const T& v, false_type) {
+		return k;
+	}
+
+	/* Auxillary function used in searchBatch.
+	   Keeps BATCH_GROUP traversals in flight, advancing each by one level per round and prefetching the next node.
+	   A traversal that finishes is replaced by the next key right away. */
+	void _searchInterleaved(const vector<T>& keys, vector<bool>& results) {
+		NODE* cur[BATCH_GROUP];
+		size_t idx[BATCH_GROUP];
+		size_t next = 0, n = keys.size();
+		int i, live = 0;
+		for (i = 0; i < BATCH_GROUP; i++) {
+			if (next < n) {
+				idx[i] = next++;
+				cur[i] = root;
+				live++;
+			}
+			else
+				cur[i] = NULL;
+		}
+
+		while (live > 0) {
+			for (i = 0; i < BATCH_GROUP; i++) {
+				NODE* t = cur[i];
+				if (t == NULL)
+					continue;
+				const T& v = keys[idx[i]];
+				if (comp(v, t->key))
+					t = t->left;
+				else if (comp(t->key, v))
+					t = t->right;
+				else {
+					results[idx[i]] = _cnt(t) > 0;
+					t = NULL;
+				}
+
+				if (t != NULL)
+					__builtin_prefetch(t);
+				else if (next < n) {
+					idx[i] = next++;
+					t = root;
+				}
+				else
+					live--;
+				cur[i] = t;
+			}
+		}
+	}
+
+	/* Auxillary function used in searchBatch.
+	   Works through ascending keys in groups of BATCH_GROUP. Every key of a group lies between its first and last key,
+	   so the group descends together to where those two part ways, then continues in lockstep like _searchInterleaved. */
+	void _searchSorted(const vector<T>& keys, vector<bool>& results) {
+		NODE* cur[BATCH_GROUP];
+		size_t b, n = keys.size();
+		for (b = 0; b < n; b += BATCH_GROUP) {
+			int i, g = (int)min((size_t)BATCH_GROUP, n - b), live = g;
+			const T& lo = keys[b], & hi = keys[b + g - 1];
+			NODE* t = root;
+			while (t != NULL) {
+				if (comp(hi, t->key))
+					t = t->left;
+				else if (comp(t->key, lo))
+					t = t->right;
+				else
+					break;
+			}
+			if (t == NULL)
+				continue;
+			for (i = 0; i < g; i++)
+				cur[i] = t;
+
+			while (live > 0) {
+				for (i = 0; i < g; i++) {
+					t = cur[i];
+					if (t == NULL)
+						continue;
+					const T& v = keys[b + i];
+					if (comp(v, t->key))
+						t = t->left;
+					else if (comp(t->key, v))
+						t = t->right;
+					else {
+						results[b + i] = _cnt(t) > 0;
+						t = NULL;
+					}
+
+					if (t != NULL)
+						__builtin_prefetch(t);
+					else
+						live--;
+					cur[i] = t;
+				}
+			}
+		}
+	}
+
+	// Returns 0 if v was rejected, 1 if a copy was added to an existing node without changing the totals,
+	// 2 if the totals grew without a new node (a copy was counted or a tombstone revived), 3 if a new node was linked.
+	// check tells whether the nodes on the way back up still have to be checked for balance.
+	int _insert(NODE*& t, T v, int depth, bool& check, NODE**& rebuildLoc) {
+		int result;
+		if (t == NULL) {
+			if (!BalancePolicy::checksPath) {
+				SizeT new_size = root ? root->size + 1 : 1;
+				if (max_size < new_size)
+					max_size = new_size;
+				check = depth > _depthBound(new_size);
+			}
+			t = _newNode(v);
+			return 3;
+		}
+		else if (comp(v, t->key))
+			result = _insert(t->left, v, depth + 1, check, rebuildLoc);
+		else if (comp(t->key, v))
+			result = _insert(t->right, v, depth + 1, check, rebuildLoc);
+		else if (isMulti || _cnt(t) == 0) {
+			if (_cnt(t) == numeric_limits<SizeT>::max())	// Nothing above t has changed yet
+				throw length_error("Too many copies of the key, use a wider SizeT");
+			SizeT w = _weight(t);
+			if (_cnt(t) == 0)
+				dead--;
+			_setCnt(t, _cnt(t) + 1);
+			_pull(t);
+			if (_weight(t) == w)
+				return 1;
+			_addTotal(t, 1);
+			return 2;
+		}
+		else
+			return 0;
+
+		if (result != 0)
+			_pull(t);
+		if (result == 3) {
+			t->size++;
+			_addTotal(t, 1);
+			if (BalancePolicy::rotates)
+				_rotateBalance(t);
+			else if (check && _isUnbalanced(t)) {
+				rebuildLoc = &t;
+				check = BalancePolicy::checksPath;	// A scapegoat tree stops at the lowest unbalanced node
+			}
+		}
+		else if (result == 2)
+			_addTotal(t, 1);
+		return result;
+	}
+
+	/* Auxillary function used in _delete. Unlinks the rightmost node of t and sets w to its weight */
+	NODE* _unlinkRightMost(NODE*& t, SizeT& w, NODE**& rebuildLoc) {
+		if (t->right == NULL) {
+			NODE* r = t;
+			w = _weight(t);
+			t = t->left;
+			return r;
+		}
+		NODE* r = _unlinkRightMost(t->right, w, rebuildLoc);
+		t->size--;
+		_addTotal(t, -w);
+		_pull(t);
+		if (BalancePolicy::rotates)
+			_rotateBalance(t);
+		else if (_isUnbalancedDelete(t, false))
+			rebuildLoc = &t;
+		return r;
+	}
+
+	// Returns 0 if v was not found, 1 if a copy was removed from a node that remains, 2 if its node was unlinked.
+	int _delete(NODE*& t, T v, NODE**& rebuildLoc) {
+		int result;
+		bool fromLeft = true;	// Which subtree of t lost the node
+		if (t == NULL)
+			return 0;
+		else if (comp(v, t->key))
+			result = _delete(t->left, v, rebuildLoc);
+		else if (comp(t->key, v)) {
+			result = _delete(t->right, v, rebuildLoc);
+			fromLeft = false;
+		}
+		else if (_cnt(t) > 1) { //Other copies remain
+			_setCnt(t, _cnt(t) - 1);
+			if (countCopies)
+				_addTotal(t, -1);
+			_pull(t);
+			return 1;
+		}
+		else { //Node found
+			if (t->left && t->right) {	//Both child nodes exist.
+				SizeT w;
+				NODE* pred = _unlinkRightMost(t->left, w, rebuildLoc);	//Unlink the inorder predecessor of t. Note that it always has 0 or 1 child nodes.
+				t->key = pred->key;										//Move its key and copies into t.
+				_setCnt(t, _cnt(pred));
+				_freeNode(pred);
+				result = 2;
+			}
+			else { //0 or 1 child nodes exist
+				NODE* successor = NULL;					//If t is a leaf, its successor is NULL. Otherwise, its successor is its sole child node.
+				if (t->left)
+					successor = t->left;
+				else
+					successor = t->right;
+				_freeNode(t);
+				t = successor;
+				return 2;
+			}
+		}
+
+		if (result == 2) {
+			t->size--;
+			_addTotal(t, -1);
+			if (!BalancePolicy::rotates && _isUnbalancedDelete(t, fromLeft))
+				rebuildLoc = &t;
+		}
+		else if (result == 1 && countCopies)
+			_addTotal(t, -1);
+		if (result != 0)
+			_pull(t);
+		if (result == 2 && BalancePolicy::rotates)
+			_rotateBalance(t);
+		return result;
+	}
+
+	/* Auxillary function used with RotationBalance, after an update changed the size of one child of t by one.
+	   Rotates the heavy child up, in two steps if its inner child is the heavier one, so t's subtree is balanced again. */
+	void _rotateBalance(NODE*& t) {
+		SizeT l = _size(t->left), r = _size(t->right);
+		if (!BalancePolicy::isUnbalanced(alpha, t->size, l, r))
+			return;
+		if (l < r) {
+			if (!BalancePolicy::isSingle(_size(t->right->left), _size(t->right->right)))
+				_rotateRight(t->right);
+			_rotateLeft(t);
+		}
+		else {
+			if (!BalancePolicy::isSingle(_size(t->left->right), _size(t->left->left)))
+				_rotateLeft(t->left);
+			_rotateRight(t);
+		}
+	}
+
+	/* Auxillary functions used in _rotateBalance. Move the right (left) child of t up into its place */
+	void _rotateLeft(NODE*& t) {
+		NODE* r = t->right;
+		t->right = r->left;
+		r->left = t;
+		_resize(t);
+		_resize(r);
+		t = r;
+	}
+
+	void _rotateRight(NODE*& t) {
+		NODE* l = t->left;
+		t->left = l->right;
+		l->right = t;
+		_resize(t);
+		_resize(l);
+		t = l;
+	}
+
+	/* Sets the size, total and aggregate of t from its children */
+	void _resize(NODE* t) {
+		t->size = 1 + _size(t->left) + _size(t->right);
+		_setTotal(t, _weight(t) + _total(t->left) + _total(t->right));
+		_pull(t);
+	}
+
+	/* Auxillary function used in removeRange. Sets the size and total of t from its children and checks its balance */
+	void _fixCut(NODE*& t, NODE**& rebuildLoc) {
+		_resize(t);
+		if (BalancePolicy::checksPath && _isUnbalanced(t))
+			rebuildLoc = &t;
+	}
+
+	/* Auxillary function used in removeRange. Finds the topmost node of t with a key in range, where the paths to lo and hi part,
+	   and replaces it by its predecessor once both sides are cut. Unbalanced nodes in both sides make that node the one to rebuild. */
+	void _cutRange(NODE*& t, const T& lo, const T& hi, vector<NODE*>& cut, NODE**& rebuildLoc) {
+		if (t == NULL)
+			return;
+		if (comp(t->key, lo))
+			_cutRange(t->right, lo, hi, cut, rebuildLoc);
+		else if (comp(hi, t->key))
+			_cutRange(t->left, lo, hi, cut, rebuildLoc);
+		else {
+			NODE** leftLoc = NULL, ** rightLoc = NULL;
+			NODE* pred = NULL;
+			NODE* top = t;
+			_cutFrom(top->left, lo, cut, &pred, leftLoc);
+			_cutTo(top->right, hi, cut, rightLoc);
+			if (pred) {
+				pred->left = top->left;
+				pred->right = top->right;
+				t = pred;
+			}
+			else
+				t = top->right;
+			if (leftLoc == &top->left)			// The links out of top now belong to pred
+				leftLoc = &t->left;
+			if (rightLoc == &top->right)
+				rightLoc = pred ? &t->right : &t;
+			top->left = top->right = NULL;
+			cut.push_back(top);
+			if (t == NULL)
+				return;
+			if (leftLoc && rightLoc)
+				rebuildLoc = &t;
+			else if (leftLoc || rightLoc)
+				rebuildLoc = leftLoc ? leftLoc : rightLoc;
+			if (!pred)
+				return;
+		}
+		_fixCut(t, rebuildLoc);
+	}
+
+	/* Auxillary function used in _cutRange. Moves the keys of t that are not less than lo into cut, going down the path to lo.
+	   If taken is given, the largest key left is unlinked into *taken on the way back, since it lies on that same path. */
+	void _cutFrom(NODE*& t, const T& lo, vector<NODE*>& cut, NODE** taken, NODE**& rebuildLoc) {
+		while (t != NULL && !comp(t->key, lo)) {	// t and its right subtree are in range
+			NODE* l = t->left;
+			if (t->right)
+				cut.push_back(t->right);
+			t->left = t->right = NULL;
+			cut.push_back(t);
+			t = l;
+		}
+		if (t == NULL)
+			return;
+		_cutFrom(t->right, lo, cut, taken, rebuildLoc);
+		if (taken && *taken == NULL && t->right == NULL) {
+			*taken = t;
+			t = t->left;
+			return;
+		}
+		_fixCut(t, rebuildLoc);
+	}
+
+	/* Auxillary function used in _cutRange. Moves the keys of t that are not greater than hi into cut, going down the path to hi */
+	void _cutTo(NODE*& t, const T& hi, vector<NODE*>& cut, NODE**& rebuildLoc) {
+		while (t != NULL && !comp(hi, t->key)) {	// t and its left subtree are in range
+			NODE* r = t->right;
+			if (t->left)
+				cut.push_back(t->left);
+			t->left = t->right = NULL;
+			cut.push_back(t);
+			t = r;
+		}
+		if (t == NULL)
+			return;
+		_cutTo(t->left, hi, cut, rebuildLoc);
+		_fixCut(t, rebuildLoc);
+	}
+
+	/* Auxillary function used in removeRange. Frees the subtrees in cut and returns the number of tombstones among them */
+	SizeT _freeCut(vector<NODE*>& cut, false_type) {
+		SizeT tombstones = 0;
+		for (size_t i = 0; i < cut.size(); i++)
+			tombstones += _freeSubtree(cut[i]);
+		return tombstones;
+	}
+
+	/* Parallelized version of _freeCut. Subtrees large enough for exec.fork are freed as pool tasks.
+	   Only used with the default allocator, which may be called from several threads at once. */
+	SizeT _freeCut(vector<NODE*>& cut, true_type) {
+		vector<future<SizeT> > fts;
+		SizeT tombstones = 0;
+		for (size_t i = 0; i < cut.size(); i++) {
+			if (exec.fork(cut[i]->size, 0))
+				fts.push_back(exec.pool.submit(&BalancedTree::_freeSubtree, this, cut[i]));
+			else
+				tombstones += _freeSubtree(cut[i]);
+		}
+		for (size_t i = 0; i < fts.size(); i++)
+			tombstones += exec.pool.get(fts[i]);
+		return tombstones;
+	}
+
+	/* Auxillary function used in _freeCut */
+	SizeT _freeSubtree(NODE* t) {
+		if (t == NULL)
+			return 0;
+		SizeT tombstones = (_cnt(t) == 0) + _freeSubtree(t->left) + _freeSubtree(t->right);
+		_freeNode(t);
+		return tombstones;
+	}
+
+	/* Lazy version of remove */
+	bool _removeLazy(T v) {
+		if (_deleteLazy(root, v) < 0)
+			return false;
+		if (dead > maxDead * (root->size + pending)) {	// The root's size lags behind by pending while the append finger is active
+			_flushFinger();
+			_rebuild(root);
+			max_size = root ? root->size : 0;
+		}
+		return true;
+	}
+
+	/* Auxillary function used in _removeLazy. Turns the node into a tombstone once its last copy is removed.
+	   Returns the weight removed from t's subtree, or -1 if v has no live copy. */
+	int _deleteLazy(NODE* t, T v) {
+		int dw;
+		if (t == NULL)
+			return -1;
+		else if (comp(v, t->key))
+			dw = _deleteLazy(t->left, v);
+		else if (comp(t->key, v))
+			dw = _deleteLazy(t->right, v);
+		else if (_cnt(t) == 0)
+			return -1;
+		else {
+			SizeT w = _weight(t);
+			_setCnt(t, isMulti ? _cnt(t) - 1 : 0);
+			if (_cnt(t) == 0)
+				dead++;
+			dw = w - _weight(t);
+		}
+
+		if (dw > 0)
+			_addTotal(t, -dw);
+		if (dw >= 0)
+			_pull(t);
+		return dw;
+	}
+
+	/* Auxillary function used in _rebuild */
+	void _getCopy(NODE* t, NODE** nodeArr, SizeT s) {
+		SizeT index = s;
+		if (t->left != NULL) {
+			index += t->left->size;
+			_getCopy(t->left, nodeArr, s);
+		}
+		nodeArr[index] = t;
+		if (t->right != NULL)
+			_getCopy(t->right, nodeArr, index + 1);
+	}
+
+	/* Auxillary function used in _getCopyP. Stores the nodes of t with ranks s..f in nodeArr[s..f] */
+	void _getCopyRange(NODE* t, NODE** nodeArr, SizeT s, SizeT f) {
+		_visitRange(t, s, f, [nodeArr](NODE* n, SizeT i) { nodeArr[i] = n; });
+	}
+
+	/* Calls visit(node, rank) for the nodes of t with ranks s..f, tombstones included, in increasing order */
+	template <typename Visit>
+	void _visitRange(NODE* t, SizeT s, SizeT f, Visit visit) {
+		vector<NODE*> stack;		// Nodes still to be visited, the next one on top
+		SizeT r = s;
+		while (t != NULL) {			// Find the node of rank s by its subtree sizes
+			SizeT l = _size(t->left);
+			if (r <= l)
+				stack.push_back(t);
+			if (r < l)
+				t = t->left;
+			else if (r == l)
+				break;
+			else {
+				r -= l + 1;
+				t = t->right;
+			}
+		}
+		for (SizeT i = s; i <= f; i++) {
+			t = stack.back();
+			stack.pop_back();
+			visit(t, i);
+			for (NODE* c = t->right; c != NULL; c = c->left)
+				stack.push_back(c);
+		}
+	}
+
+	/* Number of nodes, tombstones included, whose key is less than v, or not greater than v if inclusive is set */
+	SizeT _nodeRank(const T& v, bool inclusive) {
+		SizeT r = 0;
+		for (NODE* t = root; t != NULL; ) {
+			if (inclusive ? comp(v, t->key) : !comp(t->key, v))
+				t = t->left;
+			else {
+				r += _size(t->left) + 1;
+				t = t->right;
+			}
+		}
+		return r;
+	}
+
+	/* Auxillary functions used in parallel_for_each. Call f on the live keys of ranks s..f */
+	template <typename F>
+	void _forRange(SizeT s, SizeT e, F f) {
+		_visitRange(root, s, e, [&f](NODE* n, SizeT) {
+			if (_cnt(n) > 0)
+				f(n->key);
+		});
+	}
+
+	template <typename F>
+	void _forRanks(SizeT s, SizeT e, F& f, false_type) {
+		if (s <= e)
+			_forRange(s, e, f);
+	}
+
+	template <typename F>
+	void _forRanks(SizeT s, SizeT e, F& f, true_type) {
+		SizeT length = e - s + 1;
+		if (length <= 0)
+			return;
+		if (!exec.fork(length, 0)) {
+			_forRange(s, e, f);
+			return;
+		}
+		int parts = exec.parts();
+		vector<future<void> > fts;
+		for (int i = 1; i < parts; i++)
+			fts.push_back(exec.pool.submit(&BalancedTree::_forRange<F>, this,
+				s + SizeT((long long)length * i / parts), s + SizeT((long long)length * (i + 1) / parts) - 1, f));
+		_forRange(s, s + length / parts - 1, f);
+		for (size_t i = 0; i < fts.size(); i++)
+			exec.pool.wait(fts[i]);
+	}
+
+	/* Auxillary functions used in parallel_reduce. Fold the live keys of ranks s..e from identity, in increasing order */
+	template <typename R, typename Map, typename Combine>
+	R _reduceRange(SizeT s, SizeT e, R identity, Map map, Combine combine) {
+		R acc = identity;
+		_visitRange(root, s, e, [&](NODE* n, SizeT) {
+			if (_cnt(n) > 0)
+				acc = combine(acc, map(n->key));
+		});
+		return acc;
+	}
+
+	template <typename R, typename Map, typename Combine>
+	R _reduceRanks(SizeT s, SizeT e, R identity, Map& map, Combine& combine, false_type) {
+		return s <= e ? _reduceRange(s, e, identity, map, combine) : identity;
+	}
+
+	template <typename R, typename Map, typename Combine>
+	R _reduceRanks(SizeT s, SizeT e, R identity, Map& map, Combine& combine, true_type) {
+		SizeT length = e - s + 1;
+		if (length <= 0)
+			return identity;
+		if (!exec.fork(length, 0))
+			return _reduceRange(s, e, identity, map, combine);
+		int parts = exec.parts();
+		vector<future<R> > fts;
+		for (int i = 1; i < parts; i++)
+			fts.push_back(exec.pool.submit(&BalancedTree::_reduceRange<R, Map, Combine>, this,
+				s + SizeT((long long)length * i / parts), s + SizeT((long long)length * (i + 1) / parts) - 1, identity, map, combine));
+		R acc = _reduceRange(s, s + length / parts - 1, identity, map, combine);
+		for (size_t i = 0; i < fts.size(); i++)
+			acc = combine(acc, exec.pool.get(fts[i]));
+		return acc;
+	}
+
+	/* Parallelized version of _getCopy. Splits nodeArr into exec.parts() equal rank ranges and fills each in its own task,
+	   so the work is even however lopsided t is */
+	void _getCopyP(NODE* t, NODE** nodeArr) {
+		SizeT length = t->size;
+		if (!exec.fork(length, 0)) {
+			_getCopy(t, nodeArr, 0);
+			return;
+		}
+		int parts = exec.parts();
+		vector<future<void> > fts;
+		for (int i = 1; i < parts; i++) {
+			SizeT s = SizeT((long long)length * i / parts);
+			SizeT f = SizeT((long long)length * (i + 1) / parts) - 1;
+			fts.push_back(exec.pool.submit(&BalancedTree::_getCopyRange, this, t, nodeArr, s, f));
+		}
+		_getCopyRange(t, nodeArr, 0, length / parts - 1);
+		for (size_t i = 0; i < fts.size(); i++)
+			exec.pool.wait(fts[i]);
+	}
+
+	/* Auxillary function used in _rebuild */
+	NODE* _buildTree(NODE** nodeArr, SizeT s, SizeT f) {
+		if (s > f)
+			return NULL;
+		SizeT m = s + (f - s + 1) / 2;	// (s + f + 1) / 2 would overflow for indices past half the range of SizeT
+		NODE* t = nodeArr[m];
+		t->left = _buildTree(nodeArr, s, m - 1);
+		t->right = _buildTree(nodeArr, m + 1, f);
+		t->size = f - s + 1;
+		_setTotal(t, (countCopies || dead > 0) ? _weight(t) + _total(t->left) + _total(t->right) : t->size);
+		_pull(t);
+		return t;
+	}
+
+	/* Parallelized version of _buildTree */
+	NODE* _buildTreeP(NODE** nodeArr, SizeT s, SizeT f, int depth) {
+		if (s > f)
+			return NULL;
+		if (!exec.fork(f - s + 1, depth))
+			return _buildTree(nodeArr, s, f);
+
+		SizeT m = s + (f - s + 1) / 2;
+		NODE* t = nodeArr[m];
+		auto handler = exec.pool.submit(&BalancedTree::_buildTreeP, this, nodeArr, s, m - 1, depth + 1);
+		t->right = _buildTreeP(nodeArr, m + 1, f, depth + 1);
+		t->left = exec.pool.get(handler);
+		t->size = f - s + 1;
+		_setTotal(t, (countCopies || dead > 0) ? _weight(t) + _total(t->left) + _total(t->right) : t->size);
+		_pull(t);
+		return t;
+	}
+
+	/* Auxillary functions used in _rebuild. They pick the serial or the parallel version at compile time,
+	   so a SerialRebuild tree never instantiates the parallel ones. */
+	void _flatten(NODE* t, NODE** nodeArr, false_type) {
+		_getCopy(t, nodeArr, 0);
+	}
+
+	void _flatten(NODE* t, NODE** nodeArr, true_type) {
+		_getCopyP(t, nodeArr);
+	}
+
+	NODE* _build(NODE** nodeArr, SizeT s, SizeT f, false_type) {
+		return _buildTree(nodeArr, s, f);
+	}
+
+	NODE* _build(NODE** nodeArr, SizeT s, SizeT f, true_type) {
+		return _buildTreeP(nodeArr, s, f, 0);
+	}
+
+	/* Auxillary function used in _rebuild for the append path.
+	   Each node on the right spine gets the lightest right subtree the balance rule allows,
+	   so the spine takes roughly twice as many appends before it has to be rebuilt again. */
+	NODE* _buildSpine(NODE** nodeArr, SizeT s, SizeT f) {
+		if (s > f)
+			return NULL;
+		SizeT length = f - s + 1;
+		SizeT r = (SizeT)BalancePolicy::lightestSide(alpha, length);	// Smallest right subtree that is not too light
+		if (r < 0)
+			r = 0;
+		SizeT m = f - r;
+		NODE* t = nodeArr[m];
+		t->left = _build(nodeArr, s, m - 1, Parallel());
+		t->right = _buildSpine(nodeArr, m + 1, f);
+		t->size = length;
+		_setTotal(t, (countCopies || dead > 0) ? _weight(t) + _total(t->left) + _total(t->right) : t->size);
+		_pull(t);
+		return t;
+	}
+
+	/* Auxillary function used in _rebuild. Deletes the tombstones in nodeArr and returns the number of nodes left */
+	SizeT _dropTombstones(NODE** nodeArr, SizeT length) {
+		SizeT i, j = 0;
+		for (i = 0; i < length; i++) {
+			if (_cnt(nodeArr[i]) > 0)
+				nodeArr[j++] = nodeArr[i];
+			else {
+				if (nodeArr[i] == maxNode)
+					maxNode = NULL;
+				_freeNode(nodeArr[i]);
+			}
+		}
+		dead = 0;
+		return j;
+	}
+
+	/* Auxillary function used in _rebuildInPlace and freeze. Links the nodes of t through their right pointers in increasing key order,
+	   using right rotations only, and returns their number. Tombstones are deleted on the way if drop is set. */
+	SizeT _toVine(NODE* t, NODE*& head, bool drop) {
+		NODE** tail = &head;
+		SizeT length = 0;
+		while (t != NULL) {
+			if (t->left != NULL) {
+				NODE* l = t->left;
+				t->left = l->right;
+				l->right = t;
+				t = l;
+			}
+			else {
+				NODE* next = t->right;
+				if (drop && _cnt(t) == 0) {
+					if (t == maxNode)
+						maxNode = NULL;
+					_freeNode(t);
+				}
+				else {
+					*tail = t;
+					tail = &t->right;
+					length++;
+				}
+				t = next;
+			}
+		}
+		*tail = NULL;
+		if (drop)
+			dead = 0;
+		return length;
+	}
+
+	/* Auxillary function used in _rebuildInPlace, thaw and assign. Builds a tree of the first length nodes of the list at head and advances head past them.
+	   The shape is the one _buildTree, or _buildSpine if spine is set, gives for the same nodes. */
+	NODE* _buildVine(NODE*& head, SizeT length, bool spine) {
+		if (length == 0)
+			return NULL;
+		SizeT l = length / 2;
+		if (spine) {
+			SizeT r = (SizeT)BalancePolicy::lightestSide(alpha, length);
+			l = length - (r < 0 ? 0 : r) - 1;
+		}
+		NODE* left = _buildVine(head, l, false);
+		NODE* t = head;
+		head = head->right;
+		t->left = left;
+		t->right = _buildVine(head, length - l - 1, spine);
+		t->size = length;
+		_setTotal(t, (countCopies || dead > 0) ? _weight(t) + _total(t->left) + _total(t->right) : t->size);
+		_pull(t);
+		return t;
+	}
+
+	/* Low-memory version of _rebuild, used above the scratch limit. Takes O(n) rotations and no memory besides the recursion */
+	void _rebuildInPlace(NODE*& t, bool appending) {
+		NODE* head = NULL;
+		SizeT length = _toVine(t, head, &t == &root && dead > 0);
+		t = _buildVine(head, length, appending);
+	}
+
+	void _rebuild(NODE*& t, bool appending = false) {
+		// if (t == NULL)
+		// 	return;
+		SizeT length = t->size;
+		rebuilt += length;
+		if (_overScratchLimit(length)) {
+			_rebuildInPlace(t, appending);
+			return;
+		}
+		NODE** nodeArr = _scratch(length);
+		_flatten(t, nodeArr, Parallel());				// Make nodeArr store all nodes in increasing key order
+		if (&t == &root && dead > 0)		// Tombstones are only dropped when no ancestor's size would need fixing
+			length = _dropTombstones(nodeArr, length);
+		if (appending)
+			t = _buildSpine(nodeArr, 0, length - 1);
+		else
+			t = _build(nodeArr, 0, length - 1, Parallel());	// Rebuild the tree using the array
+	}
+
+	/* Whether an array of length node pointers would go over the scratch limit */
+	bool _overScratchLimit(SizeT length) {
+		return scratchLimit > 0 && (size_t)length * sizeof(NODE*) > scratchLimit;
+	}
+
+	/* Frees the nodes of a list linked through right, without the recursion of _clear */
+	void _freeVine(NODE* head) {
+		while (head != NULL) {
+			NODE* next = head->right;
+			_freeNode(head);
+			head = next;
+		}
+	}
+
+	/* Array of length node pointers for a rebuild. It is reused from one rebuild to the next and not zeroed,
+	   since the flatten writes every entry. */
+	NODE** _scratch(SizeT length) {
+		NODE** nodeArr = (NODE**)scratchArr.get((size_t)length * sizeof(NODE*), scratchLimit);
+		scratchPeak = max(scratchPeak, scratchArr.capacity());
+		return nodeArr;
+	}
+
+	/* Auxillary function used in the constructors and _retune. Finds the sizes at which BalancePolicy::depthBound steps up,
+	   so inserts compare the size against the next of them instead of taking two logarithms */
+	void _buildDepthTable() {
+		depthTable.clear();
+		depthLevel = 0;
+		if (BalancePolicy::checksPath)
+			return;
+		int bound = BalancePolicy::depthBound(alpha, 1);
+		depthTable.push_back(1);
+		for (;;) {
+			double guess = pow(1 / alpha, bound);	// Where the bound would step up without rounding
+			if (guess >= numeric_limits<SizeT>::max())
+				break;
+			long long s = max((long long)depthTable.back() + 1, (long long)guess);
+			while (s > depthTable.back() + 1 && BalancePolicy::depthBound(alpha, s - 1) > bound)
+				s--;
+			while (s < numeric_limits<SizeT>::max() && BalancePolicy::depthBound(alpha, s) <= bound)
+				s++;
+			if (BalancePolicy::depthBound(alpha, s) <= bound)
+				break;
+			bound = BalancePolicy::depthBound(alpha, s);
+			while ((int)depthTable.size() < bound)
+				depthTable.push_back((SizeT)s);
+		}
+	}
+
+	/* Auxillary function used in _insert. Same as BalancePolicy::depthBound(alpha, size), from the table */
+	int _depthBound(SizeT size) {
+		while (depthLevel + 1 < (int)depthTable.size() && size >= depthTable[depthLevel + 1])
+			depthLevel++;
+		while (depthLevel > 0 && size < depthTable[depthLevel])
+			depthLevel--;
+		return depthLevel + 1;
+	}
+
+	/* Auxillary function used in adaptive mode. Counts r reads and w writes, and retunes alpha once the window is full */
+	void _observe(long long r, long long w) {
+		reads += r;
+		writes += w;
+		if (reads + writes >= max((long long)ADAPT_WINDOW, (long long)(root ? root->size : 0)))
+			_retune();
+	}
+
+	/* Auxillary function used in _observe */
+	void _retune() {
+		double target = alphaLoose + (alphaTight - alphaLoose) * reads / (reads + writes);
+		bool tighten = (target - alpha) * (alphaTight - alphaLoose) > 0;
+		if (tighten && rebuilt > writes * log2((root ? root->size : 0) + 2.0))
+			target = alpha;
+		if (target != alpha && fabs(target - alpha) >= ADAPT_STEP * fabs(alphaTight - alphaLoose)) {
+			_flushFinger();		// The spine thresholds depend on alpha
+			alpha = target;
+			_buildDepthTable();
+			if (tighten && root) {
+				_rebuild(root);
+				max_size = root ? root->size : 0;
+			}
+		}
+		reads = writes = rebuilt = 0;
+	}
+
+	// Note : Does not update parent node's size field.
+	void _clear(NODE*& t) {
+		if (t == NULL)
+			return;
+		_clear(t->left);
+		_clear(t->right);
+		_freeNode(t);
+		t = NULL;
+	}
+};
+#endif
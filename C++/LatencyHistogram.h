@@ -0,0 +1,95 @@
+// LatencyHistogram.h
+// Log-bucketed latency histogram in the style of HdrHistogram.
+// Every power of two is split into 2^LH_SUB_BITS equal buckets, so a recorded value is known to within 1 / 2^LH_SUB_BITS (about 3%),
+// from single nanoseconds up to the longest rebuild, in a fixed 15 KB table.
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#define LH_SUB_BITS 5
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstdint>
+using namespace std;
+
+class LatencyHistogram {
+public:
+	LatencyHistogram(): counts((64 - LH_SUB_BITS + 1) << LH_SUB_BITS, 0) {
+		total = 0;
+		maxValue = 0;
+	}
+
+	void record(uint64_t v) {
+		counts[_index(v)]++;
+		total++;
+		if (v > maxValue)
+			maxValue = v;
+	}
+
+	// Smallest value that at least p percent of the recorded values do not exceed, rounded up to its bucket
+	uint64_t percentile(double p) {
+		if (total == 0)
+			return 0;
+		uint64_t rank = (uint64_t)(p / 100 * total + 0.5), seen = 0;
+		if (rank < 1)
+			rank = 1;
+		for (size_t i = 0; i < counts.size(); i++) {
+			seen += counts[i];
+			if (seen >= rank)
+				return min(_highest(i), maxValue);
+		}
+		return maxValue;
+	}
+
+	uint64_t max() {
+		return maxValue;
+	}
+
+	uint64_t count() {
+		return total;
+	}
+
+	void clear() {
+		fill(counts.begin(), counts.end(), 0);
+		total = 0;
+		maxValue = 0;
+	}
+
+	static void header(ostream& out) {
+		out << left << setw(24) << "(ns)" << right;
+		out << setw(12) << "p50" << setw(12) << "p99" << setw(12) << "p99.9" << setw(12) << "p99.99" << setw(12) << "max" << endl;
+	}
+
+	void report(ostream& out, const string& name) {
+		out << left << setw(24) << name << right;
+		out << setw(12) << percentile(50) << setw(12) << percentile(99) << setw(12) << percentile(99.9)
+			<< setw(12) << percentile(99.99) << setw(12) << maxValue << endl;
+	}
+
+private:
+	vector<uint64_t> counts;
+	uint64_t total;
+	uint64_t maxValue;
+
+	static size_t _index(uint64_t v) {
+		if (v < (1u << LH_SUB_BITS))
+			return (size_t)v;
+		int e = 63 - __builtin_clzll(v);		// Position of the highest set bit, at least LH_SUB_BITS
+		uint64_t m = (v >> (e - LH_SUB_BITS)) & ((1u << LH_SUB_BITS) - 1);
+		return ((size_t)(e - LH_SUB_BITS + 1) << LH_SUB_BITS) + (size_t)m;
+	}
+
+	/* Largest value that falls into bucket i */
+	static uint64_t _highest(size_t i) {
+		if (i < (1u << LH_SUB_BITS))
+			return i;
+		int e = (int)(i >> LH_SUB_BITS) + LH_SUB_BITS - 1;
+		uint64_t m = i & ((1u << LH_SUB_BITS) - 1);
+		uint64_t lo = ((uint64_t)(1u << LH_SUB_BITS) + m) << (e - LH_SUB_BITS);
+		return lo + ((uint64_t)1 << (e - LH_SUB_BITS)) - 1;
+	}
+};
+#endif
@@ -0,0 +1,37 @@
+// MemoryUsage.h
+// Memory footprint of a tree, as reported by memoryUsage().
+#ifndef MEMORYUSAGE_H
+#define MEMORYUSAGE_H
+
+#define MALLOC_HEADER 8		// Bytes malloc keeps in front of every chunk (glibc, 64-bit)
+#define MALLOC_ALIGN 16		// Chunk sizes are multiples of this
+#define MALLOC_MIN_CHUNK 32	// Smallest chunk malloc hands out
+
+#include <cstddef>
+using namespace std;
+
+struct MemoryUsage {
+	size_t nodes;		// Bytes of the nodes themselves
+	size_t overhead;	// Allocator overhead of the nodes, plus the tree object and its bookkeeping
+	size_t scratch;		// Bytes kept for the array of the next rebuild
+	size_t scratchPeak;	// Most bytes ever kept for rebuilds
+	size_t stacks;		// Stacks of the threads that carry out parallel rebuilds, shared with every other tree on the same pool
+
+	MemoryUsage(): nodes(0), overhead(0), scratch(0), scratchPeak(0), stacks(0) {}
+
+	size_t total() const {
+		return nodes + overhead + scratch + stacks;
+	}
+
+	// What the tree has needed at its worst so far, i.e. total() with the largest rebuild buffer it has kept
+	size_t peak() const {
+		return nodes + overhead + scratchPeak + stacks;
+	}
+
+	// Estimated malloc overhead of one allocation of the given size
+	static size_t mallocOverhead(size_t bytes) {
+		size_t chunk = (bytes + MALLOC_HEADER + MALLOC_ALIGN - 1) / MALLOC_ALIGN * MALLOC_ALIGN;
+		return (chunk < MALLOC_MIN_CHUNK ? MALLOC_MIN_CHUNK : chunk) - bytes;
+	}
+};
+#endif
@@ -0,0 +1,171 @@
+// PerfCounters.h
+// Hardware counters around one phase of the benchmark, read through Linux perf_event_open.
+// Counts every thread of the process, and the threads they start while counting, so work done by RebuildPool workers is included
+// even when the pool starts them during the phase.
+#ifndef PERFCOUNTERS_H
+#define PERFCOUNTERS_H
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <dirent.h>
+#endif
+using namespace std;
+
+class PerfCounters {
+public:
+	PerfCounters() {
+		enabled = false;
+		_addEvent("cycles", 0, 0);
+		_addEvent("instructions", 0, 1);
+		_addEvent("L1d-miss", 1, 0);
+		_addEvent("LLC-miss", 1, 1);
+		_addEvent("dTLB-miss", 1, 2);
+		_addEvent("branch-miss", 0, 2);
+	}
+
+	// Turns counting on. Returns false if the kernel does not let us count cycles, e.g. because of
+	// kernel.perf_event_paranoid or a container without perf support. start and stop then do nothing.
+	bool enable() {
+#ifdef __linux__
+		int fd = _open(events[0], 0);
+		if (fd < 0) {
+			error = strerror(errno);
+			return false;
+		}
+		close(fd);
+		enabled = true;
+		return true;
+#else
+		error = "perf_event_open is only available on Linux";
+		return false;
+#endif
+	}
+
+	string why() {
+		return error;
+	}
+
+	// Opens the counters on every thread that exists right now and starts them. Threads those start later inherit the counters.
+	void start() {
+#ifdef __linux__
+		if (!enabled)
+			return;
+		vector<int> tids = _threads();
+		for (size_t e = 0; e < events.size(); e++) {
+			events[e].fds.clear();
+			for (size_t i = 0; i < tids.size(); i++) {
+				int fd = _open(events[e], tids[i]);
+				if (fd >= 0)
+					events[e].fds.push_back(fd);
+			}
+		}
+		for (size_t e = 0; e < events.size(); e++)
+			for (size_t i = 0; i < events[e].fds.size(); i++)
+				ioctl(events[e].fds[i], PERF_EVENT_IOC_ENABLE, 0);
+#endif
+	}
+
+	// Stops the counters and prints each of them divided by ops, the number of operations in the phase
+	void stop(const string& name, long long ops) {
+#ifdef __linux__
+		if (!enabled)
+			return;
+		for (size_t e = 0; e < events.size(); e++)
+			for (size_t i = 0; i < events[e].fds.size(); i++)
+				ioctl(events[e].fds[i], PERF_EVENT_IOC_DISABLE, 0);
+
+		cout << name << " per op :";
+		for (size_t e = 0; e < events.size(); e++) {
+			double sum = 0;
+			for (size_t i = 0; i < events[e].fds.size(); i++) {
+				uint64_t buf[3];	// value, time enabled, time running
+				if (read(events[e].fds[i], buf, sizeof(buf)) == sizeof(buf) && buf[2] > 0)
+					sum += (double)buf[0] * buf[1] / buf[2];	// Scales up counts that were multiplexed
+				close(events[e].fds[i]);
+			}
+			cout << "  " << events[e].name << " ";
+			if (events[e].fds.empty())
+				cout << "n/a";
+			else
+				cout << sum / (ops > 0 ? ops : 1);
+			events[e].fds.clear();
+		}
+		cout << endl;
+#endif
+	}
+
+private:
+	struct EVENT {
+		const char* name;
+		uint32_t type;
+		uint64_t config;
+		vector<int> fds;	// One per thread
+	};
+	vector<EVENT> events;
+	bool enabled;
+	string error;
+
+	/* kind 0 is a generic hardware event, kind 1 a read miss in the cache selected by config */
+	void _addEvent(const char* name, int kind, int which) {
+		EVENT e;
+		e.name = name;
+#ifdef __linux__
+		static const uint64_t hw[] = { PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_BRANCH_MISSES };
+		static const uint64_t cache[] = { PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_LL, PERF_COUNT_HW_CACHE_DTLB };
+		if (kind == 0) {
+			e.type = PERF_TYPE_HARDWARE;
+			e.config = hw[which];
+		}
+		else {
+			e.type = PERF_TYPE_HW_CACHE;
+			e.config = cache[which] | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+		}
+#else
+		e.type = 0;
+		e.config = 0;
+#endif
+		events.push_back(e);
+	}
+
+#ifdef __linux__
+	int _open(const EVENT& e, int tid) {
+		struct perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = e.type;
+		attr.config = e.config;
+		attr.disabled = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.inherit = 1;	// Threads started during the phase, e.g. the pool's workers on the first parallel rebuild, add to this counter
+		attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+		return (int)syscall(__NR_perf_event_open, &attr, tid, -1, -1, 0);
+	}
+
+	vector<int> _threads() {
+		vector<int> tids;
+		DIR* dir = opendir("/proc/self/task");
+		if (dir == NULL) {
+			tids.push_back(0);	// The calling thread only
+			return tids;
+		}
+		struct dirent* d;
+		while ((d = readdir(dir)) != NULL)
+			if (d->d_name[0] != '.')
+				tids.push_back(atoi(d->d_name));
+		closedir(dir);
+		return tids;
+	}
+#endif
+};
+#endif
@@ -0,0 +1,132 @@
+// RebuildPool.h
+// A fixed set of worker threads that the parallel trees share for their rebuilds.
+#ifndef REBUILDPOOL_H
+#define REBUILDPOOL_H
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <chrono>
+#include <pthread.h>
+using namespace std;
+
+class RebuildPool {
+public:
+	RebuildPool(int Workers) {
+		if (Workers < 0)
+			throw invalid_argument("Workers must be 0 <= Workers");
+		stop = false;
+		for (int i = 0; i < Workers; i++)
+			threads.push_back(thread(&RebuildPool::_work, this));
+	}
+
+	~RebuildPool() {
+		{
+			unique_lock<mutex> lock(m);
+			stop = true;
+		}
+		cv.notify_all();
+		for (size_t i = 0; i < threads.size(); i++)
+			threads[i].join();
+	}
+
+	// Process-wide pool used by every tree that is not given its own.
+	// The thread that calls into the tree also does rebuild work, hence one worker less than the number of cores.
+	static RebuildPool& shared() {
+		static RebuildPool pool(thread::hardware_concurrency() > 1 ? thread::hardware_concurrency() - 1 : 0);
+		return pool;
+	}
+
+	int workers() {
+		return (int)threads.size();
+	}
+
+	// Address space reserved for the stacks of the workers. Most of it is never touched, so far less is resident.
+	size_t stackBytes() {
+		pthread_attr_t attr;
+		size_t size = 0;
+		if (pthread_attr_init(&attr) == 0) {
+			pthread_attr_getstacksize(&attr, &size);	// std::thread uses the default attributes
+			pthread_attr_destroy(&attr);
+		}
+		return size * threads.size();
+	}
+
+	// Queues f(args...) for the workers. With no workers, it runs right away on the calling thread instead.
+	template <typename F, typename... Args>
+	future<typename result_of<F(Args...)>::type> submit(F&& f, Args&&... args) {
+		typedef typename result_of<F(Args...)>::type R;
+		shared_ptr<packaged_task<R()> > task = make_shared<packaged_task<R()> >(bind(forward<F>(f), forward<Args>(args)...));
+		future<R> ft = task->get_future();
+		if (threads.empty()) {
+			(*task)();
+			return ft;
+		}
+		{
+			unique_lock<mutex> lock(m);
+			tasks.push([task]() { (*task)(); });
+		}
+		cv.notify_one();
+		return ft;
+	}
+
+	// Waits for a submitted task, running queued tasks on the calling thread in the meantime.
+	// Use this instead of ft.wait() whenever the caller may itself be a task, so that a worker never blocks on work
+	// that is still sitting in the queue. Rebuilds on a shared pool then cannot deadlock, however many of them overlap.
+	template <typename R>
+	void wait(future<R>& ft) {
+		while (ft.wait_for(chrono::seconds(0)) != future_status::ready) {
+			if (!_runPending())
+				ft.wait_for(chrono::microseconds(50));	// The task is running elsewhere; look for new work again soon
+		}
+	}
+
+	template <typename R>
+	R get(future<R>& ft) {
+		wait(ft);
+		return ft.get();
+	}
+
+private:
+	vector<thread> threads;
+	queue<function<void()> > tasks;
+	mutex m;
+	condition_variable cv;
+	bool stop;
+
+	/* Runs one queued task on the calling thread. Returns false if the queue was empty */
+	bool _runPending() {
+		function<void()> task;
+		{
+			unique_lock<mutex> lock(m);
+			if (tasks.empty())
+				return false;
+			task = move(tasks.front());
+			tasks.pop();
+		}
+		task();
+		return true;
+	}
+
+	void _work() {
+		while (true) {
+			function<void()> task;
+			{
+				unique_lock<mutex> lock(m);
+				cv.wait(lock, [this]() { return stop || !tasks.empty(); });
+				if (stop && tasks.empty())
+					return;
+				task = move(tasks.front());
+				tasks.pop();
+			}
+			task();
+		}
+	}
+};
+#endif
@@ -0,0 +1,108 @@
+// RebuildScratch.h
+// Reusable buffer for the array a rebuild flattens its subtree into.
+// The buffer grows geometrically and is never zeroed, so rebuilds of similar sizes reuse it without going through malloc,
+// and every byte is written once, by the flatten itself. Buffers of at least SCRATCH_HUGE bytes are mapped on their own
+// and marked for transparent huge pages, so that large rebuilds take fewer TLB misses.
+#ifndef REBUILDSCRATCH_H
+#define REBUILDSCRATCH_H
+
+#define SCRATCH_WINDOW 64		// Number of requests after which an oversized buffer is shrunk
+#define SCRATCH_HUGE (2 << 20)	// Size of a huge page, and the smallest buffer that is mapped instead of allocated
+
+#include <cstdlib>
+#include <new>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+using namespace std;
+
+class RebuildScratch {
+public:
+	RebuildScratch() {
+		buf = NULL;
+		cap = 0;
+		mapped = false;
+		recent = 0;
+		requests = 0;
+	}
+
+	RebuildScratch(const RebuildScratch&) = delete;
+	RebuildScratch& operator=(const RebuildScratch&) = delete;
+
+	~RebuildScratch() {
+		release();
+	}
+
+	// Returns at least bytes bytes of uninitialized memory, valid until the next call.
+	// The buffer grows to twice its size, but not beyond limit (0 for no limit) unless bytes itself is larger.
+	// After every SCRATCH_WINDOW requests, a buffer more than four times the largest of them is shrunk to twice that.
+	void* get(size_t bytes, size_t limit = 0) {
+		if (bytes > recent)
+			recent = bytes;
+		if (++requests >= SCRATCH_WINDOW) {
+			if (cap > 4 * recent)
+				_resize(2 * recent);
+			recent = 0;
+			requests = 0;
+		}
+		if (bytes > cap) {
+			size_t grow = 2 * cap;
+			if (limit > 0 && grow > limit)
+				grow = limit;
+			_resize(grow > bytes ? grow : bytes);
+		}
+		return buf;
+	}
+
+	size_t capacity() {
+		return cap;
+	}
+
+	// Gives the buffer back, e.g. under memory pressure. The next request allocates a new one.
+	void release() {
+		if (buf == NULL)
+			return;
+#ifdef __linux__
+		if (mapped)
+			munmap(buf, cap);
+		else
+#endif
+			free(buf);
+		buf = NULL;
+		cap = 0;
+		mapped = false;
+	}
+
+private:
+	void* buf;
+	size_t cap;
+	bool mapped;		// Whether buf comes from mmap rather than malloc
+	size_t recent;		// Largest request of the current window
+	int requests;		// Number of requests in the current window
+
+	void _resize(size_t bytes) {
+		release();
+		if (bytes == 0)
+			return;
+#ifdef __linux__
+		if (bytes >= SCRATCH_HUGE) {
+			bytes = (bytes + SCRATCH_HUGE - 1) / SCRATCH_HUGE * SCRATCH_HUGE;
+			void* p = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (p == MAP_FAILED)
+				throw bad_alloc();
+#ifdef MADV_HUGEPAGE
+			madvise(p, bytes, MADV_HUGEPAGE);
+#endif
+			buf = p;
+			cap = bytes;
+			mapped = true;
+			return;
+		}
+#endif
+		buf = malloc(bytes);
+		if (buf == NULL)
+			throw bad_alloc();
+		cap = bytes;
+	}
+};
+#endif
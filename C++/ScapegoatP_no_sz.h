@@ -0,0 +1,305 @@
+// ScapegoatP_no_sz.h
+// No "size" field in NODEs. Uses parallel subtree counting and parallel rebuilds conditionally.
+#ifndef SCAPEGOATP_NO_SZ_H
+#define SCAPEGOATP_NO_SZ_H
+
+#ifndef SCONCUR_SIZE
+#define SCONCUR_SIZE 8500	// Hands work to the pool only when subtree size is bigger than this
+#endif
+#ifndef SCONCUR_DEPTH
+#define SCONCUR_DEPTH 3 	// Results in max 2^n tasks for the pool
+#endif
+
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include "RebuildPool.h"
+#include "RebuildScratch.h"
+using namespace std;
+
+template <typename T>
+class ScapegoatP_no_sz {
+public:
+	ScapegoatP_no_sz(): pool(RebuildPool::shared()) {
+		root = NULL;
+		alpha = 0.9846154; // 0.0111111 (2)
+		size = 0;
+		max_size = 0;
+	}
+
+	ScapegoatP_no_sz(double Alpha, RebuildPool& Pool = RebuildPool::shared()): pool(Pool) {
+		if ((Alpha <= 0.5) || (1 <= Alpha))
+			throw invalid_argument("Alpha must be 0.5 < Alpha < 1");
+		root = NULL;
+		alpha = Alpha;
+		size = 0;
+		max_size = 0;
+	}
+
+	~ScapegoatP_no_sz() {
+		_clear(root);
+	}
+
+	bool search(T v) {
+		return _search(root, v) != NULL;
+	}
+
+	bool insert(T v) {
+		long long curr_size = 0;
+		return _insert(root, v, 0, curr_size);
+	}
+
+	bool remove(T v) {
+		bool result = _delete(root, v);
+		if (size <= max_size / 2) {
+			_rebuild(root, size, -1);
+			max_size = size;
+		}
+		return result;
+	}
+
+	void rebuild() {
+		_rebuild(root, size, -1);
+	}
+
+	void clear() {
+		_clear(root);
+	}
+
+private:
+	struct NODE {
+		NODE* left, * right;
+		T key;
+
+		NODE(T v) {
+			left = right = NULL;
+			key = v;
+		}
+	};
+	NODE* root;
+	long long size, max_size;
+	double alpha;
+	RebuildPool& pool;
+	RebuildScratch scratch;	// Holds the array of every rebuild
+
+	NODE* _search(NODE* t, T v) {
+		if (t == NULL)
+			return NULL;
+		else if (v < t->key)
+			return _search(t->left, v);
+		else if (v > t->key)
+			return _search(t->right, v);
+		else
+			return t;
+	}
+
+	/* Auxillary function used in _countP. Counts the nodes of t until limit of them were counted, and returns false if that left
+	   nodes uncounted. The subtrees it did not reach are then in rest, each of them whole and none of them counted. */
+	bool _countUpTo(NODE* t, long long limit, long long& cnt, vector<NODE*>& rest) {
+		if (t == NULL)
+			return true;
+		if (cnt >= limit) {
+			rest.push_back(t);
+			return false;
+		}
+		cnt++;
+		bool left = _countUpTo(t->left, limit, cnt, rest);
+		return _countUpTo(t->right, limit, cnt, rest) && left;
+	}
+
+	/* Counts the subtrees (*rest)[s..f - 1] in parallel, halving the range at each level */
+	long long _countRest(const vector<NODE*>* rest, size_t s, size_t f, int depth) {
+		if (f - s == 1)
+			return _countP((*rest)[s], depth);
+		if (depth >= SCONCUR_DEPTH) {
+			long long cnt = 0;
+			for (size_t i = s; i < f; i++)
+				cnt += _count((*rest)[i]);
+			return cnt;
+		}
+
+		size_t m = (s + f) / 2;
+		auto handler = pool.submit(&ScapegoatP_no_sz<T>::_countRest, this, rest, s, m, depth + 1);
+		long long right = _countRest(rest, m, f, depth + 1);
+		return pool.get(handler) + right;
+	}
+
+	/* Parallelized version of _count. The first SCONCUR_SIZE nodes are counted serially, so only larger subtrees reach the pool */
+	long long _countP(NODE* t, int depth) {
+		if (depth >= SCONCUR_DEPTH)
+			return _count(t);
+		long long cnt = 0;
+		vector<NODE*> rest;
+		if (_countUpTo(t, SCONCUR_SIZE, cnt, rest))
+			return cnt;
+		return cnt + _countRest(&rest, 0, rest.size(), depth + 1);
+	}
+
+	/* Auxillary function used in _countP */
+	long long _count(NODE* t) {
+		if (t == NULL)
+			return 0;
+		return _count(t->left) + _count(t->right) + 1;
+	}
+
+	/* Auxillary function used in _insert. Small subtrees are counted serially.
+	   Larger ones keep the serial count of their first SCONCUR_SIZE nodes, and the pool counts the rest. */
+	long long get_size(NODE* t) {
+		return _countP(t, 0);
+	}
+
+	bool _insert(NODE*& t, T v, int depth, long long& curr_size) {
+		bool result, is_left;
+		if (t == NULL) {
+			t = new NODE(v);
+			size++;
+			if (max_size < size)
+				max_size = size;
+			if (depth > int(log(size) / log(1 / alpha)) + 1)
+				curr_size = 1;
+			return true;
+		}
+		else if (v < t->key) {
+			result = _insert(t->left, v, depth + 1, curr_size);
+			is_left = true;
+		}
+		else if (v > t->key) {
+			result = _insert(t->right, v, depth + 1, curr_size);
+			is_left = false;
+		}
+		else
+			return false;
+
+		if (curr_size > 0) {
+			long long tot, left, right;
+			if (is_left) {
+				left = curr_size;
+				right = get_size(t->right);
+			}
+			else {
+				left = get_size(t->left);
+				right = curr_size;
+			}
+			tot = left + right + 1;
+			if (left > alpha * tot || right > alpha * tot) {
+				_rebuild(t, tot, left);
+				curr_size = 0;
+			}
+			else
+				curr_size = tot;
+		}
+		return result;
+	}
+
+	/* Auxillary function used in _delete */
+	NODE* _getRightMost(NODE* t) {
+		while (t->right != NULL)
+			t = t->right;
+		return t;
+	}
+
+	bool _delete(NODE*& t, T v) {
+		if (t == NULL)
+			return false;
+		else if (v < t->key)
+			return _delete(t->left, v);
+		else if (v > t->key)
+			return _delete(t->right, v);
+		else { //Node found
+			if (t->left && t->right) {	//Both child nodes exist.
+				t->key = _getRightMost(t->left)->key;	//Find the inorder predecessor of t and copy its key.
+				_delete(t->left, t->key);				//Delete the inorder predecessor. Note that it always has 0 or 1 child nodes.
+			}
+			else { //0 or 1 child nodes exist
+				NODE* successor = NULL;					//If t is a leaf, its successor is NULL. Otherwise, its successor is its sole child node.
+				if (t->left)
+					successor = t->left;
+				else
+					successor = t->right;
+				delete t;
+				t = successor;
+				size--;
+			}
+			return true;
+		}
+	}
+
+	/* Auxillary function used in _rebuild */
+	void _getCopy(NODE* t, NODE** nodeArr, long long& index) {
+		if (t->left != NULL)
+			_getCopy(t->left, nodeArr, index);
+		nodeArr[index++] = t;
+		if (t->right != NULL)
+			_getCopy(t->right, nodeArr, index);
+	}
+
+	/* Parallelized version of _getCopy. length is the number of nodes in t, and leftSize that of t->left, or -1 if not counted yet.
+	   Subtrees of SCONCUR_SIZE nodes and more are split at their root and their halves copied on the pool, down to SCONCUR_DEPTH,
+	   so the uneven children of a scapegoat are split again by their own counted sizes. */
+	void _getCopyP(NODE* t, NODE** nodeArr, long long length, long long leftSize, int depth) {
+		if (length < SCONCUR_SIZE || depth >= SCONCUR_DEPTH) {
+			long long index = 0;
+			_getCopy(t, nodeArr, index);
+			return;
+		}
+		if (leftSize < 0)
+			leftSize = get_size(t->left);
+
+		nodeArr[leftSize] = t;
+		auto handler = pool.submit(&ScapegoatP_no_sz<T>::_getCopyPart, this, t->left, nodeArr, leftSize, depth + 1);
+		_getCopyPart(t->right, nodeArr + leftSize + 1, length - leftSize - 1, depth + 1);
+		pool.wait(handler);
+	}
+
+	/* Auxillary function used in _getCopyP */
+	void _getCopyPart(NODE* t, NODE** nodeArr, long long length, int depth) {
+		if (t != NULL)
+			_getCopyP(t, nodeArr, length, -1, depth);
+	}
+
+	/* Auxillary function used in _rebuild */
+	NODE* _buildTree(NODE** nodeArr, long long s, long long f) {
+		if (s > f)
+			return NULL;
+		long long m = s + (f - s + 1) / 2;
+		NODE* t = nodeArr[m];
+		t->left = _buildTree(nodeArr, s, m - 1);
+		t->right = _buildTree(nodeArr, m + 1, f);
+		return t;
+	}
+
+	/* Parallelized version of _buildTree */
+	NODE* _buildTreeP(NODE** nodeArr, long long s, long long f, int depth) {
+		if (s > f)
+			return NULL;
+		if (f - s + 1 < SCONCUR_SIZE || depth >= SCONCUR_DEPTH)
+			return _buildTree(nodeArr, s, f);
+
+		long long m = s + (f - s + 1) / 2;
+		NODE* t = nodeArr[m];
+		auto handler = pool.submit(&ScapegoatP_no_sz<T>::_buildTreeP, this, nodeArr, s, m - 1, depth + 1);
+		t->right = _buildTreeP(nodeArr, m + 1, f, depth + 1);
+		t->left = pool.get(handler);
+		return t;
+	}
+
+	/* length is the number of nodes in t. leftSize is the number of nodes in t->left, or -1 if unknown */
+	void _rebuild(NODE*& t, long long length, long long leftSize) {
+		if (t == NULL)
+			return;
+		NODE** nodeArr = (NODE**)scratch.get(length * sizeof(NODE*));	// Sized from the count _insert already has
+		_getCopyP(t, nodeArr, length, leftSize, 0);		// Make nodeArr store all nodes in increasing key order
+		t = _buildTreeP(nodeArr, 0, length - 1, 0);		// Rebuild the tree using the array
+	}
+
+	void _clear(NODE*& t) {
+		if (t == NULL)
+			return;
+		_clear(t->left);
+		_clear(t->right);
+		delete t;
+		t = NULL;
+		size--;
+	}
+};
+#endif
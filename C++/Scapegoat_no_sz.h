@@ -1,7 +1,7 @@
-// Scapgegoat_no_sz.h
+// Scapegoat_no_sz.h
 // No "size" field in NODEs.
-#ifndef SCAPEGOAT_H
-#define SCAPEGOAT_H
+#ifndef SCAPEGOAT_NO_SZ_H
+#define SCAPEGOAT_NO_SZ_H
 
 #include <iostream>
 #include <vector>
@@ -9,16 +9,16 @@
 using namespace std;
 
 template <typename T>
-class Scapegoat {
+class Scapegoat_no_sz {
 public:
-	Scapegoat() {
+	Scapegoat_no_sz() {
 		root = NULL;
 		alpha = 0.9846154; // 0.0111111 (2)
 		size = 0;
 		max_size = 0;
 	}
 
-	Scapegoat(double Alpha) {
+	Scapegoat_no_sz(double Alpha) {
 		if ((Alpha <= 0.5) || (1 <= Alpha))
 			throw invalid_argument("Alpha must be 0.5 < Alpha < 1");
 		root = NULL;
@@ -27,7 +27,7 @@ public:
 		max_size = 0;
 	}
 
-	~Scapegoat() {
+	~Scapegoat_no_sz() {
 		_clear(root);
 	}
 
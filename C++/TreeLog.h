@@ -0,0 +1,423 @@
+// TreeLog.h
+// Write-ahead log of the inserts and removes of a tree, with group commit and checkpoints.
+// Path.log holds the operations since the last checkpoint, Path.ckpt the keys as of that checkpoint.
+// Operations are buffered and written with a single fdatasync per group, so a crash loses at most the uncommitted group.
+// recover() loads the checkpoint straight into a balanced tree with assign(), then sorts the logged operations by key
+// and merges them into the checkpoint in one pass, instead of replaying them one insert at a time.
+// TREE is any BalancedTree. T has to be trivially copyable, since keys are written as raw bytes.
+#ifndef TREELOG_H
+#define TREELOG_H
+
+#define LOG_GROUP 1024		// Operations per group commit by default
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <stdexcept>
+#include <type_traits>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+using namespace std;
+
+template <typename TREE>
+class TreeLog {
+	typedef typename TREE::key_type T;
+	typedef typename TREE::key_compare Compare;
+	typedef typename TREE::size_type SizeT;
+	static_assert(is_trivially_copyable<T>::value, "TreeLog writes keys as raw bytes");
+
+public:
+	// Opens the log of the files Path.log and Path.ckpt, creating them if needed. Call recover() before the first operation,
+	// so the tree starts from what the files hold. GroupSize is the number of operations per group commit.
+	TreeLog(TREE& Tree, const string& Path, int GroupSize = LOG_GROUP): tree(Tree) {
+		if (GroupSize <= 0)
+			throw invalid_argument("GroupSize must be positive");
+		logPath = Path + ".log";
+		ckptPath = Path + ".ckpt";
+		groupSize = GroupSize;
+		buffered = 0;
+		fd = -1;
+		generation = 0;
+	}
+
+	TreeLog(const TreeLog&) = delete;
+	TreeLog& operator=(const TreeLog&) = delete;
+
+	~TreeLog() {
+		try {
+			commit();
+		}
+		catch (...) {}
+		if (fd >= 0)
+			close(fd);
+	}
+
+	// Inserts v into the tree and logs it. Durable once the group it belongs to is committed.
+	// If logging it throws, the insert is undone first, so the tree never holds what the log cannot.
+	bool insert(T v) {
+		bool result = tree.insert(v);
+		if (result) {
+			try {
+				_append(OP_INSERT, v);
+			}
+			catch (...) {
+				tree.remove(v);
+				throw;
+			}
+		}
+		return result;
+	}
+
+	bool remove(T v) {
+		bool result = tree.remove(v);
+		if (result) {
+			try {
+				_append(OP_REMOVE, v);
+			}
+			catch (...) {
+				tree.insert(v);
+				throw;
+			}
+		}
+		return result;
+	}
+
+	// Writes the buffered operations as one group and waits for them to reach the disk.
+	// If that fails, whatever part of the group was written is cut off again and the operations stay buffered for the next commit.
+	void commit() {
+		if (buffered == 0)
+			return;
+		_checkOpen();
+		GROUP g;
+		g.count = buffered;
+		g.reserved = 0;
+		g.checksum = _checksum(buffer.data() + sizeof(GROUP), buffer.size() - sizeof(GROUP));
+		memcpy(buffer.data(), &g, sizeof(GROUP));
+		off_t start = lseek(fd, 0, SEEK_CUR);
+		if (start < 0)
+			_fail("lseek", logPath);
+		try {
+			_write(fd, buffer.data(), buffer.size(), logPath);
+			_sync(fd, logPath);
+		}
+		catch (...) {
+			if (ftruncate(fd, start) == 0)
+				lseek(fd, start, SEEK_SET);
+			throw;
+		}
+		buffer.clear();
+		buffered = 0;
+	}
+
+	// Writes every key of the tree to a new checkpoint and empties the log.
+	// The checkpoint is written to a temporary file and renamed over the old one, so a crash leaves one of the two intact.
+	// It carries the generation of the log that follows it, so a log left over from before the checkpoint is ignored.
+	void checkpoint() {
+		commit();
+		_checkOpen();
+		vector<T> keys;
+		vector<SizeT> counts;
+		tree.dump(keys, counts);
+
+		string tmpPath = ckptPath + ".tmp";
+		int cfd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (cfd < 0)
+			_fail("open", tmpPath);
+		CHECKPOINT c;
+		c.magic = CKPT_MAGIC;
+		c.generation = generation + 1;
+		c.length = keys.size();
+		c.keySize = sizeof(T);
+		c.countSize = sizeof(SizeT);
+		c.checksum = _checksum(keys.data(), keys.size() * sizeof(T), _checksum(counts.data(), counts.size() * sizeof(SizeT)));
+		_write(cfd, &c, sizeof(c), tmpPath);
+		_write(cfd, keys.data(), keys.size() * sizeof(T), tmpPath);
+		_write(cfd, counts.data(), counts.size() * sizeof(SizeT), tmpPath);
+		_sync(cfd, tmpPath);
+		close(cfd);
+		if (rename(tmpPath.c_str(), ckptPath.c_str()) != 0)
+			_fail("rename", tmpPath);
+		_syncDir();
+
+		generation++;
+		if (ftruncate(fd, 0) != 0)
+			_fail("ftruncate", logPath);
+		_writeHeader();
+	}
+
+	// Rebuilds the tree from the checkpoint and the log, and opens the log for appending.
+	// A group cut short by a crash, and everything after it, is dropped. Returns the number of operations replayed.
+	long long recover() {
+		if (fd >= 0)
+			close(fd);
+		fd = -1;
+		vector<T> keys;
+		vector<SizeT> counts;
+		generation = 0;
+		_readCheckpoint(keys, counts);
+
+		fd = open(logPath.c_str(), O_RDWR | O_CREAT, 0644);
+		if (fd < 0)
+			_fail("open", logPath);
+		vector<RECORD> ops;
+		off_t valid = _readLog(ops);
+		if (valid == 0) {
+			ops.clear();
+			if (ftruncate(fd, 0) != 0)
+				_fail("ftruncate", logPath);
+			_writeHeader();
+		}
+		else {
+			if (ftruncate(fd, valid) != 0)
+				_fail("ftruncate", logPath);
+			if (lseek(fd, valid, SEEK_SET) < 0)
+				_fail("lseek", logPath);
+		}
+
+		if (!ops.empty())
+			_merge(keys, counts, ops, tree.key_comp());
+		tree.assign(keys, counts);
+		buffer.clear();
+		buffered = 0;
+		return (long long)ops.size();
+	}
+
+private:
+	enum { OP_INSERT = 1, OP_REMOVE = 2 };
+	static const uint64_t LOG_MAGIC = 0x31474f4c45455254ULL;	// "TREELOG1"
+	static const uint64_t CKPT_MAGIC = 0x31504b4345455254ULL;	// "TREECKP1"
+
+	struct HEADER {
+		uint64_t magic;
+		uint64_t generation;
+	};
+
+	struct GROUP {
+		uint32_t count;		// Operations that follow, each one op byte and then the key
+		uint32_t reserved;
+		uint64_t checksum;	// Of the operations, so a group torn by a crash is recognized
+	};
+
+	struct CHECKPOINT {
+		uint64_t magic;
+		uint64_t generation;
+		uint64_t length;	// Keys that follow, then as many counts
+		uint32_t keySize;
+		uint32_t countSize;
+		uint64_t checksum;
+	};
+
+	struct RECORD {
+		T key;
+		int op;
+	};
+
+	TREE& tree;
+	string logPath, ckptPath;
+	int groupSize;
+	int fd;
+	uint64_t generation;	// Of the current checkpoint and log
+	vector<char> buffer;	// Space for the GROUP header, then the buffered operations
+	int buffered;
+
+	/* Buffers one operation, and commits the group once it is full. If the commit throws, the operation is taken out again,
+	   so that the caller can undo it on the tree. */
+	void _append(char op, const T& v) {
+		if (buffer.empty())
+			buffer.resize(sizeof(GROUP));
+		size_t mark = buffer.size();
+		buffer.push_back(op);
+		const char* p = reinterpret_cast<const char*>(&v);
+		buffer.insert(buffer.end(), p, p + sizeof(T));
+		if (++buffered >= groupSize) {
+			try {
+				commit();
+			}
+			catch (...) {
+				buffer.resize(mark);
+				buffered--;
+				throw;
+			}
+		}
+	}
+
+	/* Auxillary function used in recover. Leaves keys and counts empty if there is no checkpoint yet */
+	void _readCheckpoint(vector<T>& keys, vector<SizeT>& counts) {
+		int cfd = open(ckptPath.c_str(), O_RDONLY);
+		if (cfd < 0) {
+			if (errno == ENOENT)
+				return;
+			_fail("open", ckptPath);
+		}
+		CHECKPOINT c;
+		bool ok = _read(cfd, &c, sizeof(c)) && c.magic == CKPT_MAGIC && c.keySize == sizeof(T) && c.countSize == sizeof(SizeT);
+		if (ok) {
+			keys.resize(c.length);
+			counts.resize(c.length);
+			ok = _read(cfd, keys.data(), keys.size() * sizeof(T)) && _read(cfd, counts.data(), counts.size() * sizeof(SizeT))
+				&& c.checksum == _checksum(keys.data(), keys.size() * sizeof(T), _checksum(counts.data(), counts.size() * sizeof(SizeT)));
+		}
+		close(cfd);
+		if (!ok)
+			throw runtime_error("Corrupt checkpoint " + ckptPath);
+		generation = c.generation;
+	}
+
+	/* Auxillary function used in recover. Reads the complete groups of a log of the current generation into ops,
+	   and returns the length of the log up to the end of the last of them, or 0 if the log has to be started anew */
+	off_t _readLog(vector<RECORD>& ops) {
+		off_t end = lseek(fd, 0, SEEK_END);
+		if (end < 0 || lseek(fd, 0, SEEK_SET) < 0)
+			_fail("lseek", logPath);
+		vector<char> data(end);
+		if (!_read(fd, data.data(), data.size()))
+			_fail("read", logPath);
+		HEADER h;
+		if (data.size() < sizeof(h))
+			return 0;
+		memcpy(&h, data.data(), sizeof(h));
+		if (h.magic != LOG_MAGIC || h.generation != generation)
+			return 0;		// Written before the checkpoint was, so the checkpoint already holds its operations
+
+		size_t pos = sizeof(h), record = 1 + sizeof(T);
+		while (pos + sizeof(GROUP) <= data.size()) {
+			GROUP g;
+			memcpy(&g, data.data() + pos, sizeof(g));
+			size_t bytes = (size_t)g.count * record;
+			if (data.size() - pos - sizeof(g) < bytes || g.checksum != _checksum(data.data() + pos + sizeof(g), bytes))
+				break;
+			for (const char* p = data.data() + pos + sizeof(g); p < data.data() + pos + sizeof(g) + bytes; p += record) {
+				RECORD r;
+				r.op = p[0];
+				memcpy(&r.key, p + 1, sizeof(T));
+				ops.push_back(r);
+			}
+			pos += sizeof(g) + bytes;
+		}
+		return (off_t)pos;
+	}
+
+	/* Auxillary function used in recover. Applies ops, in the order they were logged, to the checkpoint in keys and counts.
+	   The operations are sorted by key, keeping the order of those on the same key, and merged with the keys in one pass. */
+	void _merge(vector<T>& keys, vector<SizeT>& counts, vector<RECORD>& ops, Compare comp) {
+		stable_sort(ops.begin(), ops.end(), [&comp](const RECORD& a, const RECORD& b) { return comp(a.key, b.key); });
+		bool multi = tree.isMultiset();
+		vector<T> mergedKeys;
+		vector<SizeT> mergedCounts;
+		mergedKeys.reserve(keys.size() + ops.size());
+		mergedCounts.reserve(keys.size() + ops.size());
+		size_t i = 0, j = 0;
+		while (i < keys.size() || j < ops.size()) {
+			if (j == ops.size() || (i < keys.size() && comp(keys[i], ops[j].key))) {
+				mergedKeys.push_back(keys[i]);
+				mergedCounts.push_back(counts[i]);
+				i++;
+				continue;
+			}
+			T key = ops[j].key;
+			SizeT cnt = 0;
+			if (i < keys.size() && !comp(key, keys[i]))
+				cnt = counts[i++];
+			for (; j < ops.size() && !comp(key, ops[j].key); j++) {
+				if (ops[j].op == OP_INSERT)
+					cnt = multi ? cnt + 1 : 1;
+				else if (cnt > 0)
+					cnt--;
+			}
+			if (cnt > 0) {
+				mergedKeys.push_back(key);
+				mergedCounts.push_back(cnt);
+			}
+		}
+		keys.swap(mergedKeys);
+		counts.swap(mergedCounts);
+	}
+
+	void _writeHeader() {
+		HEADER h;
+		h.magic = LOG_MAGIC;
+		h.generation = generation;
+		if (lseek(fd, 0, SEEK_SET) < 0)
+			_fail("lseek", logPath);
+		_write(fd, &h, sizeof(h), logPath);
+		_sync(fd, logPath);
+	}
+
+	void _checkOpen() {
+		if (fd < 0)
+			throw logic_error("The log is not open, call recover() first");
+	}
+
+	/* FNV-1a over bytes, continuing from seed */
+	static uint64_t _checksum(const void* data, size_t bytes, uint64_t seed = 14695981039346656037ULL) {
+		const unsigned char* p = static_cast<const unsigned char*>(data);
+		uint64_t h = seed;
+		for (size_t i = 0; i < bytes; i++) {
+			h ^= p[i];
+			h *= 1099511628211ULL;
+		}
+		return h;
+	}
+
+	static void _write(int f, const void* data, size_t bytes, const string& path) {
+		const char* p = static_cast<const char*>(data);
+		while (bytes > 0) {
+			ssize_t n = ::write(f, p, bytes);
+			if (n < 0 && errno == EINTR)
+				continue;
+			if (n <= 0)
+				_fail("write", path);
+			p += n;
+			bytes -= n;
+		}
+	}
+
+	/* Returns false if the file ends before bytes bytes */
+	static bool _read(int f, void* data, size_t bytes) {
+		char* p = static_cast<char*>(data);
+		while (bytes > 0) {
+			ssize_t n = ::read(f, p, bytes);
+			if (n < 0 && errno == EINTR)
+				continue;
+			if (n <= 0)
+				return false;
+			p += n;
+			bytes -= n;
+		}
+		return true;
+	}
+
+	static void _sync(int f, const string& path) {
+#ifdef __linux__
+		if (fdatasync(f) != 0)
+#else
+		if (fsync(f) != 0)
+#endif
+			_fail("fsync", path);
+	}
+
+	/* Makes the rename of the checkpoint durable */
+	void _syncDir() {
+		size_t slash = ckptPath.rfind('/');
+		string dir = slash == string::npos ? "." : slash == 0 ? "/" : ckptPath.substr(0, slash);
+		int dfd = open(dir.c_str(), O_RDONLY);
+		if (dfd < 0)
+			_fail("open", dir);
+		if (fsync(dfd) != 0) {
+			int e = errno;
+			close(dfd);
+			errno = e;
+			_fail("fsync", dir);
+		}
+		close(dfd);
+	}
+
+	static void _fail(const char* what, const string& path) {
+		throw runtime_error(string(what) + " " + path + " : " + strerror(errno));
+	}
+};
+#endif
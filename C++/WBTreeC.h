@@ -0,0 +1,247 @@
+// WBTreeC.h
+// Amortized weight balanced tree with compact nodes.
+// Nodes live in an index-addressed pool and refer to their children by 32-bit indices,
+// so a NODE with int keys takes 16 bytes instead of 24 (plus malloc overhead per node).
+#ifndef WBTREEC_H
+#define WBTREEC_H
+
+#define WC_NIL UINT32_MAX	// Null child index
+
+#include <iostream>
+#include <vector>
+#include <cstdint>
+#include <stdexcept>
+#include "MemoryUsage.h"
+#include "RebuildScratch.h"
+using namespace std;
+
+template <typename T>
+class WBTreeC {
+public:
+	WBTreeC() {
+		root = WC_NIL;
+		freeList = WC_NIL;
+		alpha = 0.32;
+		scratchPeak = 0;
+	}
+
+	WBTreeC(double Alpha) {
+		if ((Alpha <= 0) || (0.5 <= Alpha))
+			throw invalid_argument("Alpha must be 0 < Alpha < 0.5");
+		root = WC_NIL;
+		freeList = WC_NIL;
+		alpha = Alpha;
+		scratchPeak = 0;
+	}
+
+	bool search(T v) {
+		return _search(root, v) != WC_NIL;
+	}
+
+	// Throws length_error once the pool holds WC_NIL nodes, since the next index would read as null
+	bool insert(T v) {
+		_reserveOne();		// No reallocation may happen while references into pool are held
+		uint32_t* rebuildLoc = NULL;
+		bool result = _insert(root, v, rebuildLoc);
+		if (rebuildLoc)
+			_rebuild(*rebuildLoc);
+		return result;
+	}
+
+	bool remove(T v) {
+		uint32_t* rebuildLoc = NULL;
+		bool result = _delete(root, v, rebuildLoc);
+		if (rebuildLoc)
+			_rebuild(*rebuildLoc);
+		return result;
+	}
+
+	void rebuild() {
+		_rebuild(root);
+	}
+
+	void clear() {
+		vector<NODE>().swap(pool);	// Gives the memory back, as the pointer trees free their nodes
+		root = WC_NIL;
+		freeList = WC_NIL;
+	}
+
+	// Preallocates the pool for n nodes, avoiding the copies made when it grows.
+	void reserve(uint32_t n) {
+		pool.reserve(n);
+	}
+
+	// Bytes used by the tree. Free and unused slots of the pool count as overhead. See MemoryUsage.h.
+	MemoryUsage memoryUsage() {
+		MemoryUsage m;
+		m.nodes = _size(root) * sizeof(NODE);
+		m.overhead = sizeof(*this) + (pool.capacity() - _size(root)) * sizeof(NODE) + MemoryUsage::mallocOverhead(pool.capacity() * sizeof(NODE));
+		m.scratch = scratchArr.capacity();
+		m.scratchPeak = scratchPeak;
+		return m;
+	}
+
+private:
+	struct NODE {
+		uint32_t left, right;
+		T key;
+		uint32_t size;
+	};
+	vector<NODE> pool;
+	uint32_t root;
+	uint32_t freeList;	// Freed nodes, linked through their left field
+	double alpha;
+	RebuildScratch scratchArr;	// Index array of every rebuild, kept from one to the next
+	size_t scratchPeak;			// Most bytes scratchArr has held
+
+	/* Auxillary function used in insert */
+	void _reserveOne() {
+		if (freeList == WC_NIL && pool.size() >= WC_NIL)
+			throw length_error("The node pool is full");
+		if (freeList == WC_NIL && pool.size() == pool.capacity())
+			pool.reserve(pool.empty() ? 16 : pool.size() * 2);
+	}
+
+	uint32_t _newNode(T v) {
+		uint32_t t;
+		if (freeList != WC_NIL) {
+			t = freeList;
+			freeList = pool[t].left;
+		}
+		else {
+			t = (uint32_t)pool.size();
+			pool.push_back(NODE());
+		}
+		pool[t].left = pool[t].right = WC_NIL;
+		pool[t].key = v;
+		pool[t].size = 1;
+		return t;
+	}
+
+	void _freeNode(uint32_t t) {
+		pool[t].left = freeList;
+		freeList = t;
+	}
+
+	uint32_t _size(uint32_t t) {
+		return t == WC_NIL ? 0 : pool[t].size;
+	}
+
+	bool _isUnbalanced(uint32_t t) {
+		double thres = alpha * (pool[t].size + 1);
+		if (_size(pool[t].left) + 1 < thres)
+			return true;
+		else if (_size(pool[t].right) + 1 < thres)
+			return true;
+		return false;
+	}
+
+	uint32_t _search(uint32_t t, T v) {
+		while (t != WC_NIL) {
+			if (v < pool[t].key)
+				t = pool[t].left;
+			else if (v > pool[t].key)
+				t = pool[t].right;
+			else
+				return t;
+		}
+		return WC_NIL;
+	}
+
+	bool _insert(uint32_t& t, T v, uint32_t*& rebuildLoc) {
+		bool result;
+		if (t == WC_NIL) {
+			t = _newNode(v);
+			return true;
+		}
+		else if (v < pool[t].key)
+			result = _insert(pool[t].left, v, rebuildLoc);
+		else if (v > pool[t].key)
+			result = _insert(pool[t].right, v, rebuildLoc);
+		else
+			return false;
+
+		if (result) {
+			pool[t].size++;
+			if (_isUnbalanced(t))
+				rebuildLoc = &t;
+		}
+		return result;
+	}
+
+	/* Auxillary function used in _delete */
+	uint32_t _getRightMost(uint32_t t) {
+		while (pool[t].right != WC_NIL)
+			t = pool[t].right;
+		return t;
+	}
+
+	bool _delete(uint32_t& t, T v, uint32_t*& rebuildLoc) {
+		bool result;
+		if (t == WC_NIL)
+			return false;
+		else if (v < pool[t].key)
+			result = _delete(pool[t].left, v, rebuildLoc);
+		else if (v > pool[t].key)
+			result = _delete(pool[t].right, v, rebuildLoc);
+		else { //Node found
+			if (pool[t].left != WC_NIL && pool[t].right != WC_NIL) {	//Both child nodes exist.
+				pool[t].key = pool[_getRightMost(pool[t].left)].key;	//Find the inorder predecessor of t and copy its key.
+				_delete(pool[t].left, pool[t].key, rebuildLoc);		//Delete the inorder predecessor. Note that it always has 0 or 1 child nodes.
+				result = true;
+			}
+			else { //0 or 1 child nodes exist
+				uint32_t successor;					//If t is a leaf, its successor is WC_NIL. Otherwise, its successor is its sole child node.
+				if (pool[t].left != WC_NIL)
+					successor = pool[t].left;
+				else
+					successor = pool[t].right;
+				_freeNode(t);
+				t = successor;
+				return true;
+			}
+		}
+
+		if (result) {
+			pool[t].size--;
+			if (_isUnbalanced(t))
+				rebuildLoc = &t;
+		}
+		return result;
+	}
+
+	/* Auxillary function used in _rebuild */
+	void _getCopy(uint32_t t, uint32_t* idxArr, uint32_t s) {
+		uint32_t index = s;
+		if (pool[t].left != WC_NIL) {
+			index += pool[pool[t].left].size;
+			_getCopy(pool[t].left, idxArr, s);
+		}
+		idxArr[index] = t;
+		if (pool[t].right != WC_NIL)
+			_getCopy(pool[t].right, idxArr, index + 1);
+	}
+
+	/* Auxillary function used in _rebuild. Links idxArr[s..f], s <= f, into a balanced subtree.
+	   Indices are unsigned, so the empty halves are skipped instead of passed on as f = s - 1. */
+	uint32_t _buildTree(uint32_t* idxArr, uint32_t s, uint32_t f) {
+		uint32_t m = s + (f - s + 1) / 2;
+		uint32_t t = idxArr[m];
+		pool[t].left = m > s ? _buildTree(idxArr, s, m - 1) : WC_NIL;
+		pool[t].right = m < f ? _buildTree(idxArr, m + 1, f) : WC_NIL;
+		pool[t].size = f - s + 1;
+		return t;
+	}
+
+	void _rebuild(uint32_t& t) {
+		if (t == WC_NIL)
+			return;
+		uint32_t length = pool[t].size;
+		uint32_t* idxArr = (uint32_t*)scratchArr.get((size_t)length * sizeof(uint32_t));
+		if (scratchArr.capacity() > scratchPeak)
+			scratchPeak = scratchArr.capacity();
+		_getCopy(t, idxArr, 0);					// Make idxArr store all nodes in increasing key order
+		t = _buildTree(idxArr, 0, length - 1);	// Rebuild the tree using the array
+	}
+};
+#endif
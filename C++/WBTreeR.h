@@ -0,0 +1,13 @@
+// WBTreeR.h
+// Weight balanced tree rebalanced by rotations, with O(log n) worst case updates instead of amortized rebuilds
+#ifndef WBTREER_H
+#define WBTREER_H
+
+#define WROT_DELTA 3	// Neither child may weigh more than this many times the other
+#define WROT_GAMMA 2	// Single rotation while the inner grandchild weighs less than this many times the outer one
+
+#include "BalancedTree.h"
+
+template <typename T>
+using WBTreeR = BalancedTree<T, less<T>, RotationBalance<WROT_DELTA, WROT_GAMMA>, SerialRebuild>;
+#endif
@@ -0,0 +1,231 @@
+// Workload.h
+// Operation traces for the benchmark : skewed key distributions, YCSB style operation mixes,
+// and insertion orders that keep partial rebuild trees rebuilding.
+// A trace is generated up front, so every tree replays exactly the same operations and generating them is never timed.
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+
+#define ZIPF_THETA 0.99		// Skew of the Zipfian distribution, as in YCSB
+#define HOT_KEYS 0.2		// Fraction of the keys that form the hot set of the hotspot distribution
+#define HOT_OPS 0.8		// Fraction of the operations that go to the hot set
+#define SCAN_MAX 100		// Longest scan, in keys
+
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+using namespace std;
+
+enum class KeyDistribution { UNIFORM, ZIPFIAN, HOTSPOT, WINDOW };
+
+// UPDATE removes a key and inserts it again. RMW (read-modify-write) searches it first.
+// SCAN searches len consecutive keys, since the trees have no iterators.
+enum class WorkloadOpType { SEARCH, INSERT, REMOVE, UPDATE, RMW, SCAN };
+static const int WORKLOAD_OP_TYPES = 6;
+
+struct WorkloadOp {
+	WorkloadOpType type;
+	int key;
+	int len;
+};
+
+struct WorkloadMix {
+	const char* name;
+	int percent[WORKLOAD_OP_TYPES];	// Share of each WorkloadOpType in declaration order, summing to 100
+	KeyDistribution dist;
+};
+
+// YCSB core workloads A-F, followed by mixes with removes.
+// Inserts always add new keys above all existing ones. WINDOW reads and removes follow them :
+// reads pick among the most recent keys, and removes retire the oldest one, so the tree holds a sliding window.
+static const WorkloadMix WORKLOAD_MIXES[] = {
+	//                       search insert remove update rmw scan
+	{ "YCSB A (update heavy)", { 50, 0, 0, 50, 0, 0 }, KeyDistribution::ZIPFIAN },
+	{ "YCSB B (read mostly)",  { 95, 0, 0, 5, 0, 0 }, KeyDistribution::ZIPFIAN },
+	{ "YCSB C (read only)",    { 100, 0, 0, 0, 0, 0 }, KeyDistribution::ZIPFIAN },
+	{ "YCSB D (read latest)",  { 95, 5, 0, 0, 0, 0 }, KeyDistribution::WINDOW },
+	{ "YCSB E (short scans)",  { 0, 5, 0, 0, 0, 95 }, KeyDistribution::ZIPFIAN },
+	{ "YCSB F (read-modify-write)", { 50, 0, 0, 0, 50, 0 }, KeyDistribution::ZIPFIAN },
+	{ "Churn (uniform)",       { 40, 30, 30, 0, 0, 0 }, KeyDistribution::UNIFORM },
+	{ "Churn (hotspot)",       { 40, 30, 30, 0, 0, 0 }, KeyDistribution::HOTSPOT },
+	{ "Sliding window",        { 50, 25, 25, 0, 0, 0 }, KeyDistribution::WINDOW }
+};
+static const int WORKLOAD_MIX_COUNT = sizeof(WORKLOAD_MIXES) / sizeof(WORKLOAD_MIXES[0]);
+
+class Workload {
+public:
+	// Keys 0 .. Loaded - 1 are assumed to be in the tree already (see load). WindowSize is the number of recent keys WINDOW reads pick from.
+	Workload(int Loaded, int WindowSize = 1000, unsigned Seed = 1): rng(Seed) {
+		if (Loaded <= 0 || WindowSize <= 0)
+			throw invalid_argument("Loaded and WindowSize must be positive");
+		loaded = Loaded;
+		windowSize = WindowSize;
+		_initZipf(Loaded);
+	}
+
+	// Keys 0 .. loaded - 1 in random order, to insert before replaying a trace
+	vector<int> load() {
+		vector<int> keys(loaded);
+		for (int i = 0; i < loaded; i++)
+			keys[i] = i;
+		shuffle(keys.begin(), keys.end(), rng);
+		return keys;
+	}
+
+	// ops operations drawn from mix, to replay on a tree that holds exactly the loaded keys
+	vector<WorkloadOp> trace(const WorkloadMix& mix, int ops) {
+		vector<WorkloadOp> result(ops);
+		int next = loaded, oldest = 0;
+		uniform_int_distribution<int> pct(0, 99), scanLen(1, SCAN_MAX);
+		for (int i = 0; i < ops; i++) {
+			int r = pct(rng), type = 0;
+			while (type < WORKLOAD_OP_TYPES - 1 && r >= mix.percent[type]) {
+				r -= mix.percent[type];
+				type++;
+			}
+			WorkloadOp& op = result[i];
+			op.type = (WorkloadOpType)type;
+			op.len = 1;
+			if (op.type == WorkloadOpType::INSERT)
+				op.key = next++;
+			else if (op.type == WorkloadOpType::REMOVE && mix.dist == KeyDistribution::WINDOW)
+				op.key = (oldest < next - 1) ? oldest++ : oldest;
+			else
+				op.key = _pick(mix.dist, oldest, next);
+			if (op.type == WorkloadOpType::SCAN)
+				op.len = scanLen(rng);
+		}
+		return result;
+	}
+
+	// Inserts keys 0 .. n - 1 from both ends inwards (0, n - 1, 1, n - 2, ...), then removes them in the same order.
+	// All inserts land in the single gap left in the middle and each one extends the same zig-zag path,
+	// so a scapegoat tree rebuilds after every few inserts, with no append to shortcut it.
+	static vector<WorkloadOp> zigzag(int n) {
+		vector<int> keys;
+		for (int lo = 0, hi = n - 1; lo <= hi; lo++, hi--) {
+			keys.push_back(lo);
+			if (lo < hi)
+				keys.push_back(hi);
+		}
+		return _insertRemove(keys);
+	}
+
+	// Inserts keys 0 .. n - 1 as ascending runs of block keys, the runs in random order, then removes them in the same order.
+	// Each run grows a path into one gap of the tree, so rebuilds are frequent but smaller than for a fully sorted input.
+	vector<WorkloadOp> sortedBlocks(int n, int block) {
+		if (block <= 0)
+			throw invalid_argument("block must be positive");
+		vector<int> starts, keys;
+		for (int s = 0; s < n; s += block)
+			starts.push_back(s);
+		shuffle(starts.begin(), starts.end(), rng);
+		for (size_t i = 0; i < starts.size(); i++)
+			for (int k = starts[i]; k < n && k < starts[i] + block; k++)
+				keys.push_back(k);
+		return _insertRemove(keys);
+	}
+
+	// Replays trace on tree and returns the number of operations that succeeded.
+	// Every tree that replays the same trace from the same contents has to return the same number.
+	template <typename TREE>
+	static long long run(TREE& tree, const vector<WorkloadOp>& trace) {
+		long long hits = 0;
+		for (size_t i = 0; i < trace.size(); i++)
+			hits += apply(tree, trace[i]);
+		return hits;
+	}
+
+	// Carries out op on tree and returns how many of its steps succeeded : 0 or 1, or up to len for a SCAN
+	template <typename TREE>
+	static int apply(TREE& tree, const WorkloadOp& op) {
+		int hits = 0;
+		switch (op.type) {
+		case WorkloadOpType::SEARCH:
+			return tree.search(op.key);
+		case WorkloadOpType::INSERT:
+			return tree.insert(op.key);
+		case WorkloadOpType::REMOVE:
+			return tree.remove(op.key);
+		case WorkloadOpType::RMW:
+			if (!tree.search(op.key))
+				return 0;
+			// Falls through
+		case WorkloadOpType::UPDATE:
+			return tree.remove(op.key) && tree.insert(op.key);
+		case WorkloadOpType::SCAN:
+			for (int k = op.key; k < op.key + op.len; k++)
+				hits += tree.search(k);
+			break;
+		}
+		return hits;
+	}
+
+private:
+	mt19937_64 rng;
+	int loaded, windowSize;
+	// Zipfian generator of Gray et al., "Quickly generating billion-record synthetic databases", over ranks 0 .. zipfSize - 1
+	int zipfSize;
+	double zetan, eta, zipfAlpha, zipfHalf;
+
+	void _initZipf(int n) {
+		zetan = 0;
+		for (int i = 1; i <= n; i++)
+			zetan += 1 / pow((double)i, ZIPF_THETA);
+		zipfSize = n;
+		zipfAlpha = 1 / (1 - ZIPF_THETA);
+		zipfHalf = 1 + pow(0.5, ZIPF_THETA);
+		eta = (1 - pow(2.0 / n, 1 - ZIPF_THETA)) / (1 - zipfHalf / zetan);
+	}
+
+	int _zipfRank() {
+		double u = uniform_real_distribution<double>(0, 1)(rng), uz = u * zetan;
+		if (uz < 1)
+			return 0;
+		if (uz < zipfHalf)
+			return 1;
+		int r = (int)(zipfSize * pow(eta * u - eta + 1, zipfAlpha));
+		return r < zipfSize ? r : zipfSize - 1;
+	}
+
+	/* Scatters the popular ranks over the key space, as YCSB's scrambled Zipfian does, so the hot keys are not neighbours in the tree */
+	static int _scramble(int rank, int n) {
+		uint64_t h = 14695981039346656037ULL;	// FNV-1a
+		for (int i = 0; i < 4; i++) {
+			h ^= (rank >> (8 * i)) & 0xff;
+			h *= 1099511628211ULL;
+		}
+		return (int)(h % n);
+	}
+
+	/* A key for a search, remove or update. Keys below oldest were retired by WINDOW removes, keys from next on do not exist yet */
+	int _pick(KeyDistribution dist, int oldest, int next) {
+		switch (dist) {
+		case KeyDistribution::ZIPFIAN:
+			return _scramble(_zipfRank(), loaded);
+		case KeyDistribution::HOTSPOT: {
+			int hot = max(1, (int)(loaded * HOT_KEYS));
+			if (uniform_real_distribution<double>(0, 1)(rng) < HOT_OPS)
+				return uniform_int_distribution<int>(0, hot - 1)(rng);
+			return uniform_int_distribution<int>(0, next - 1)(rng);
+		}
+		case KeyDistribution::WINDOW:
+			return uniform_int_distribution<int>(max(oldest, next - windowSize), next - 1)(rng);
+		default:
+			return uniform_int_distribution<int>(0, next - 1)(rng);
+		}
+	}
+
+	static vector<WorkloadOp> _insertRemove(const vector<int>& keys) {
+		vector<WorkloadOp> result(2 * keys.size());
+		for (size_t i = 0; i < keys.size(); i++) {
+			WorkloadOp ins = { WorkloadOpType::INSERT, keys[i], 1 }, rem = { WorkloadOpType::REMOVE, keys[i], 1 };
+			result[i] = ins;
+			result[keys.size() + i] = rem;
+		}
+		return result;
+	}
+};
+#endif
@@ -1,13 +1,25 @@
 #include <cstdio>
+#include <cstdlib>
 #include <ctime>
 #include <chrono>
 #include <random>
 #include <algorithm>
+#include <vector>
+#include <stdexcept>
+#include <cstdint>
+#include <map>
 #include "Scapegoat.h"
-//#include "Scapegoat_no_sz.h"
+#include "Scapegoat_no_sz.h"
 #include "ScapegoatP.h"
+#include "ScapegoatP_no_sz.h"
 #include "WBTree.h"
 #include "WBTreeP.h"
+#include "WBTreeC.h"
+#include "WBTreeR.h"
+#include "PerfCounters.h"
+#include "LatencyHistogram.h"
+#include "Workload.h"
+#include "TreeLog.h"
 
 #define K	(N/2)
 #define N	10000000
@@ -15,6 +27,7 @@
 using namespace std;
 
 int arr[N + 10] = { 0 };
+PerfCounters perf;	// Reports hardware counters per operation for each timed phase once enabled with --perf
 
 int benchRebuildS(int n, bool shuffle) {
 	Scapegoat<int> s_tree;
@@ -30,17 +43,21 @@ int benchRebuildS(int n, bool shuffle) {
 	for (i = 0; i < n; i++)
 		if (!s_tree.insert(arr[i]))
 			return -1;
+	perf.start();
 	wcts = chrono::system_clock::now();
 	s_tree.rebuild();
 	wt1 = (chrono::system_clock::now() - wcts);
+	perf.stop("Scapegoat (rebuild)", n);
 	s_tree.clear();
 
 	for (i = 0; i < n; i++)
 		if (!sp_tree.insert(arr[i]))
 			return -1;
+	perf.start();
 	wcts = chrono::system_clock::now();
 	sp_tree.rebuild();
 	wt2 = (chrono::system_clock::now() - wcts);
+	perf.stop("ScapegoatP (rebuild)", n);
 	sp_tree.clear();
 
 	cout << "Scapegoat  " << wt1.count() << " seconds (Wall Clock)" << endl;
@@ -62,17 +79,21 @@ int benchRebuildW(int n, bool shuffle) {
 	for (i = 0; i < n; i++)
 		if (!wb_tree.insert(arr[i]))
 			return -1;
+	perf.start();
 	wcts = chrono::system_clock::now();
 	wb_tree.rebuild();
 	wt1 = (chrono::system_clock::now() - wcts);
+	perf.stop("WBTree (rebuild)", n);
 	wb_tree.clear();
 
 	for (i = 0; i < n; i++)
 		if (!wbp_tree.insert(arr[i]))
 			return -1;
+	perf.start();
 	wcts = chrono::system_clock::now();
 	wbp_tree.rebuild();
 	wt2 = (chrono::system_clock::now() - wcts);
+	perf.stop("WBTreeP (rebuild)", n);
 	wbp_tree.clear();
 
 	cout << "WBTree  " << wt1.count() << " seconds (Wall Clock)" << endl;
@@ -91,29 +112,37 @@ int benchAllS(int n, bool shuffle) {
 	if (shuffle)
 		random_shuffle(&arr[0], &arr[n - 1] + 1);
 
+	perf.start();
 	wcts = chrono::system_clock::now();
 	for (i = 0; i < n; i++)
 		if (!s_tree.insert(arr[i]))
 			return -1;
 	wt1 = (chrono::system_clock::now() - wcts);
+	perf.stop("Scapegoat (insert)", n);
 	
+	perf.start();
 	wcts = chrono::system_clock::now();
 	for (i = 0; i < n; i++)
 		if (!s_tree.remove(arr[i]))
 			return -1;
 	wt2 = (chrono::system_clock::now() - wcts);
+	perf.stop("Scapegoat (remove)", n);
 
+	perf.start();
 	wcts = chrono::system_clock::now();
 	for (i = 0; i < n; i++)
 		if (!sp_tree.insert(arr[i]))
 			return -1;
 	wt3 = (chrono::system_clock::now() - wcts);
+	perf.stop("ScapegoatP (insert)", n);
 
+	perf.start();
 	wcts = chrono::system_clock::now();
 	for (i = 0; i < n; i++)
 		if (!sp_tree.remove(arr[i]))
 			return -1;
 	wt4 = (chrono::system_clock::now() - wcts);
+	perf.stop("ScapegoatP (remove)", n);
 
 	cout << "Scapegoat  (insert) " << wt1.count() << " seconds (Wall Clock)" << endl;
 	cout << "Scapegoat  (remove) " << wt2.count() << " seconds (Wall Clock)" << endl;
@@ -133,29 +162,37 @@ int benchAllW(int n, bool shuffle) {
 	if (shuffle)
 		random_shuffle(&arr[0], &arr[n - 1] + 1);
 
+	perf.start();
 	wcts = chrono::system_clock::now();
 	for (i = 0; i < n; i++)
 		if (!wb_tree.insert(arr[i]))
 			return -1;
 	wt1 = (chrono::system_clock::now() - wcts);
+	perf.stop("WBTree (insert)", n);
 
+	perf.start();
 	wcts = chrono::system_clock::now();
 	for (i = 0; i < n; i++)
 		if (!wb_tree.remove(arr[i]))
 			return -1;
 	wt2 = (chrono::system_clock::now() - wcts);
+	perf.stop("WBTree (remove)", n);
 
+	perf.start();
 	wcts = chrono::system_clock::now();
 	for (i = 0; i < n; i++)
 		if (!wbp_tree.insert(arr[i]))
 			return -1;
 	wt3 = (chrono::system_clock::now() - wcts);
+	perf.stop("WBTreeP (insert)", n);
 
+	perf.start();
 	wcts = chrono::system_clock::now();
 	for (i = 0; i < n; i++)
 		if (!wbp_tree.remove(arr[i]))
 			return -1;
 	wt4 = (chrono::system_clock::now() - wcts);
+	perf.stop("WBTreeP (remove)", n);
 
 	cout << "WBTree  (insert) " << wt1.count() << " seconds (Wall Clock)" << endl;
 	cout << "WBTree  (remove) " << wt2.count() << " seconds (Wall Clock)" << endl;
@@ -164,8 +201,1202 @@ int benchAllW(int n, bool shuffle) {
 	return 0;
 }
 
-int main() {
-	benchRebuildW(N, true);
-	benchAllW(N, false);
+int benchAllC(int n, bool shuffle) {
+	WBTree<int> wb_tree;
+	WBTreeC<int> wbc_tree;
+	chrono::system_clock::time_point wcts;
+	chrono::duration<double> wt1, wt2, wt3, wt4;
+	int i;
+	for (i = 0; i < n; i++)
+		arr[i] = i;
+	if (shuffle)
+		random_shuffle(&arr[0], &arr[n - 1] + 1);
+
+	perf.start();
+	wcts = chrono::system_clock::now();
+	for (i = 0; i < n; i++)
+		if (!wb_tree.insert(arr[i]))
+			return -1;
+	wt1 = (chrono::system_clock::now() - wcts);
+	perf.stop("WBTree (insert)", n);
+
+	perf.start();
+	wcts = chrono::system_clock::now();
+	for (i = 0; i < n; i++)
+		if (!wb_tree.remove(arr[i]))
+			return -1;
+	wt2 = (chrono::system_clock::now() - wcts);
+	perf.stop("WBTree (remove)", n);
+
+	perf.start();
+	wcts = chrono::system_clock::now();
+	for (i = 0; i < n; i++)
+		if (!wbc_tree.insert(arr[i]))
+			return -1;
+	wt3 = (chrono::system_clock::now() - wcts);
+	perf.stop("WBTreeC (insert)", n);
+
+	perf.start();
+	wcts = chrono::system_clock::now();
+	for (i = 0; i < n; i++)
+		if (!wbc_tree.remove(arr[i]))
+			return -1;
+	wt4 = (chrono::system_clock::now() - wcts);
+	perf.stop("WBTreeC (remove)", n);
+
+	cout << "WBTree  (insert) " << wt1.count() << " seconds (Wall Clock)" << endl;
+	cout << "WBTree  (remove) " << wt2.count() << " seconds (Wall Clock)" << endl;
+	cout << "WBTreeC (insert) " << wt3.count() << " seconds (Wall Clock)" << endl;
+	cout << "WBTreeC (remove) " << wt4.count() << " seconds (Wall Clock)" << endl;
+	return 0;
+}
+
+// n lookups with search, with searchBatch in batches of batch keys, unsorted and sorted, and with search on the frozen tree.
+// Only the even keys are in the tree, so half of the lookups miss. Every result of searchBatch is checked against search afterwards.
+int benchSearchW(int n, int batch) {
+	WBTree<int> wb_tree;
+	chrono::system_clock::time_point wcts;
+	chrono::duration<double> wt1, wt2, wt3, wt4;
+	vector<int> keys(batch);
+	vector<bool> results;
+	int i, j, found1 = 0, found2 = 0, found3 = 0, found4 = 0;
+	for (i = 0; i < n; i++)
+		arr[i] = i;
+	random_shuffle(&arr[0], &arr[n - 1] + 1);
+	for (i = 0; i < n; i++)
+		if (arr[i] % 2 == 0 && !wb_tree.insert(arr[i]))
+			return -1;
+	random_shuffle(&arr[0], &arr[n - 1] + 1);
+
+	perf.start();
+	wcts = chrono::system_clock::now();
+	for (i = 0; i + batch <= n; i += batch)
+		for (j = 0; j < batch; j++)
+			found1 += wb_tree.search(arr[i + j]);
+	wt1 = (chrono::system_clock::now() - wcts);
+	perf.stop("WBTree (search)", n);
+
+	perf.start();
+	wcts = chrono::system_clock::now();
+	for (i = 0; i + batch <= n; i += batch) {
+		keys.assign(&arr[i], &arr[i] + batch);
+		wb_tree.searchBatch(keys, results);
+		found2 += count(results.begin(), results.end(), true);
+	}
+	wt2 = (chrono::system_clock::now() - wcts);
+	perf.stop("WBTree (searchBatch)", n);
+
+	perf.start();
+	wcts = chrono::system_clock::now();
+	for (i = 0; i + batch <= n; i += batch) {
+		keys.assign(&arr[i], &arr[i] + batch);
+		sort(keys.begin(), keys.end());
+		wb_tree.searchBatch(keys, results);
+		found3 += count(results.begin(), results.end(), true);
+	}
+	wt3 = (chrono::system_clock::now() - wcts);
+	perf.stop("WBTree (searchBatch sorted)", n);
+
+	for (i = 0; i + batch <= n; i += batch)
+		for (int sorted = 0; sorted < 2; sorted++) {
+			keys.assign(&arr[i], &arr[i] + batch);
+			if (sorted)
+				sort(keys.begin(), keys.end());
+			wb_tree.searchBatch(keys, results);
+			for (j = 0; j < batch; j++)
+				if (results[j] != wb_tree.search(keys[j]))
+					return -1;
+		}
+
+	wb_tree.freeze();
+	perf.start();
+	wcts = chrono::system_clock::now();
+	for (i = 0; i + batch <= n; i += batch)
+		for (j = 0; j < batch; j++)
+			found4 += wb_tree.search(arr[i + j]);
+	wt4 = (chrono::system_clock::now() - wcts);
+	perf.stop("WBTree (search frozen)", n);
+	if (found1 != found2 || found1 != found3 || found1 != found4)
+		return -1;
+
+	cout << "WBTree (search)             " << wt1.count() << " seconds (Wall Clock)" << endl;
+	cout << "WBTree (searchBatch)        " << wt2.count() << " seconds (Wall Clock)" << endl;
+	cout << "WBTree (searchBatch sorted) " << wt3.count() << " seconds (Wall Clock)" << endl;
+	cout << "WBTree (search frozen)      " << wt4.count() << " seconds (Wall Clock)" << endl;
+	return 0;
+}
+
+// Removing the middle half of the keys, one remove per key and with a single removeRange
+int benchRangeW(int n) {
+	WBTree<int> wb_tree;
+	WBTreeP<int> wbp_tree;
+	chrono::system_clock::time_point wcts;
+	chrono::duration<double> wt1, wt2, wt3;
+	int i;
+	for (i = 0; i < n; i++)
+		arr[i] = i;
+	random_shuffle(&arr[0], &arr[n - 1] + 1);
+
+	for (i = 0; i < n; i++)
+		if (!wb_tree.insert(arr[i]))
+			return -1;
+	perf.start();
+	wcts = chrono::system_clock::now();
+	for (i = n / 4; i < n / 4 * 3; i++)
+		if (!wb_tree.remove(i))
+			return -1;
+	wt1 = (chrono::system_clock::now() - wcts);
+	perf.stop("WBTree (remove)", n / 2);
+	wb_tree.clear();
+
+	for (i = 0; i < n; i++)
+		if (!wb_tree.insert(arr[i]))
+			return -1;
+	perf.start();
+	wcts = chrono::system_clock::now();
+	if (wb_tree.removeRange(n / 4, n / 4 * 3 - 1) != n / 2)
+		return -1;
+	wt2 = (chrono::system_clock::now() - wcts);
+	perf.stop("WBTree (removeRange)", n / 2);
+	wb_tree.clear();
+
+	for (i = 0; i < n; i++)
+		if (!wbp_tree.insert(arr[i]))
+			return -1;
+	perf.start();
+	wcts = chrono::system_clock::now();
+	if (wbp_tree.removeRange(n / 4, n / 4 * 3 - 1) != n / 2)
+		return -1;
+	wt3 = (chrono::system_clock::now() - wcts);
+	perf.stop("WBTreeP (removeRange)", n / 2);
+	wbp_tree.clear();
+
+	cout << "WBTree  (remove)      " << wt1.count() << " seconds (Wall Clock)" << endl;
+	cout << "WBTree  (removeRange) " << wt2.count() << " seconds (Wall Clock)" << endl;
+	cout << "WBTreeP (removeRange) " << wt3.count() << " seconds (Wall Clock)" << endl;
+	return 0;
+}
+
+// Sum of all keys with parallel_reduce, on the calling thread and on the pool
+int benchScanW(int n) {
+	WBTree<int> wb_tree;
+	WBTreeP<int> wbp_tree;
+	chrono::system_clock::time_point wcts;
+	chrono::duration<double> wt1, wt2;
+	long long sum1, sum2;
+	int i;
+	for (i = 0; i < n; i++)
+		arr[i] = i;
+	random_shuffle(&arr[0], &arr[n - 1] + 1);
+	for (i = 0; i < n; i++)
+		if (!wb_tree.insert(arr[i]) || !wbp_tree.insert(arr[i]))
+			return -1;
+
+	perf.start();
+	wcts = chrono::system_clock::now();
+	sum1 = wb_tree.parallel_reduce(0LL, [](int k) { return (long long)k; }, [](long long a, long long b) { return a + b; });
+	wt1 = (chrono::system_clock::now() - wcts);
+	perf.stop("WBTree (parallel_reduce)", n);
+
+	perf.start();
+	wcts = chrono::system_clock::now();
+	sum2 = wbp_tree.parallel_reduce(0LL, [](int k) { return (long long)k; }, [](long long a, long long b) { return a + b; });
+	wt2 = (chrono::system_clock::now() - wcts);
+	perf.stop("WBTreeP (parallel_reduce)", n);
+	if (sum1 != sum2)
+		return -1;
+
+	cout << "WBTree  (parallel_reduce) " << wt1.count() << " seconds (Wall Clock)" << endl;
+	cout << "WBTreeP (parallel_reduce) " << wt2.count() << " seconds (Wall Clock)" << endl;
+	return 0;
+}
+
+// std::map of key counts with the interface of the trees, as the reference of replayOf. Follows multiset rules if Multi is set.
+struct RefTree {
+	map<int, long long> keys;
+	bool multi;
+
+	RefTree(bool Multi = false): multi(Multi) {}
+
+	bool search(int v) {
+		return keys.count(v) > 0;
+	}
+
+	bool insert(int v) {
+		long long& c = keys[v];
+		if (c > 0 && !multi)
+			return false;
+		c++;
+		return true;
+	}
+
+	bool remove(int v) {
+		map<int, long long>::iterator it = keys.find(v);
+		if (it == keys.end())
+			return false;
+		if (--it->second == 0)
+			keys.erase(it);
+		return true;
+	}
+
+	long long count(int v) {
+		map<int, long long>::iterator it = keys.find(v);
+		return it == keys.end() ? 0 : it->second;
+	}
+
+	// Number of keys below v, or of their copies if countCopies is set
+	long long rank(int v, bool countCopies) {
+		long long r = 0;
+		for (map<int, long long>::iterator it = keys.begin(); it != keys.end() && it->first < v; ++it)
+			r += countCopies ? it->second : 1;
+		return r;
+	}
+
+	long long size(bool countCopies) {
+		long long r = 0;
+		for (map<int, long long>::iterator it = keys.begin(); it != keys.end(); ++it)
+			r += countCopies ? it->second : 1;
+		return r;
+	}
+};
+
+/* Differential replay shared by the self-checking benches. Draws ops operations from gen(i), the WorkloadOp of step i, and hands them
+   to run(tree, trace, results), which carries them out on tree with the timing of its bench and stores what each one returned.
+   They are then replayed on ref, which has to hold what tree held before, and check(i, op, ref) may compare what the bench kept of step i.
+   Returns 0, or -1 if a result differs, check fails, or tree and ref disagree on a key of the trace or of ref. */
+template <typename TREE, typename GEN, typename RUN, typename CHECK>
+int replayOf(TREE& tree, RefTree& ref, int ops, GEN gen, RUN run, CHECK check) {
+	vector<WorkloadOp> trace(ops);
+	vector<int> results(ops);
+	for (int i = 0; i < ops; i++)
+		trace[i] = gen(i);
+	run(tree, trace, results);
+	for (int i = 0; i < ops; i++)
+		if (Workload::apply(ref, trace[i]) != results[i] || !check(i, trace[i], ref))
+			return -1;
+	// A key tree holds and ref does not was inserted by the trace, so these two cover every key either of them holds
+	for (int i = 0; i < ops; i++)
+		if (tree.search(trace[i].key) != ref.search(trace[i].key))
+			return -1;
+	for (map<int, long long>::iterator it = ref.keys.begin(); it != ref.keys.end(); ++it)
+		if (!tree.search(it->first))
+			return -1;
+	return 0;
+}
+
+template <typename TREE, typename GEN, typename RUN>
+int replayOf(TREE& tree, RefTree& ref, int ops, GEN gen, RUN run) {
+	return replayOf(tree, ref, ops, gen, run, [](int i, const WorkloadOp& op, RefTree& ref) { return true; });
+}
+
+// The run of replayOf for the benches that time a whole trace. Stores the wall clock time in wt.
+struct TimedRun {
+	string name;
+	double& wt;
+
+	TimedRun(const string& Name, double& Wt): name(Name), wt(Wt) {}
+
+	template <typename TREE>
+	void operator()(TREE& tree, const vector<WorkloadOp>& trace, vector<int>& results) {
+		chrono::system_clock::time_point wcts = chrono::system_clock::now();
+		perf.start();
+		for (size_t i = 0; i < trace.size(); i++)
+			results[i] = Workload::apply(tree, trace[i]);
+		perf.stop(name, trace.size());
+		wt = chrono::duration<double>(chrono::system_clock::now() - wcts).count();
+	}
+};
+
+/* Auxillary function used in benchFixed, benchNoSize, benchRotation and benchLocalDelete. Inserts and then removes arr[0..n-1] and returns the time taken */
+template <typename TREE>
+double fixedOf(TREE& tree, int n, const string& name) {
+	RefTree ref;
+	double wt;
+	if (replayOf(tree, ref, 2 * n, [n](int i) -> WorkloadOp {
+			WorkloadOp op = { i < n ? WorkloadOpType::INSERT : WorkloadOpType::REMOVE, arr[i % n], 1 };
+			return op;
+		}, TimedRun(name, wt)))
+		return -1;
+	return wt;
+}
+
+// Scapegoat trees with and without the size field, serial and parallel, at the alpha of each.
+// The size-less ones count the sibling subtrees on the path of every insert that has to look for a scapegoat.
+int benchNoSize(int n, bool shuffle) {
+	Scapegoat<int> s_tree;
+	ScapegoatP<int> sp_tree;
+	Scapegoat_no_sz<int> sn_tree;
+	ScapegoatP_no_sz<int> spn_tree;
+	double wt[4];
+	int i;
+	for (i = 0; i < n; i++)
+		arr[i] = i;
+	if (shuffle)
+		random_shuffle(&arr[0], &arr[n - 1] + 1);
+
+	wt[0] = fixedOf(s_tree, n, "Scapegoat");
+	wt[1] = fixedOf(sp_tree, n, "ScapegoatP");
+	wt[2] = fixedOf(sn_tree, n, "Scapegoat_no_sz");
+	wt[3] = fixedOf(spn_tree, n, "ScapegoatP_no_sz");
+	for (i = 0; i < 4; i++)
+		if (wt[i] < 0)
+			return -1;
+	cout << "Scapegoat        (insert + remove) " << wt[0] << " seconds (Wall Clock)" << endl;
+	cout << "ScapegoatP       (insert + remove) " << wt[1] << " seconds (Wall Clock)" << endl;
+	cout << "Scapegoat_no_sz  (insert + remove) " << wt[2] << " seconds (Wall Clock)" << endl;
+	cout << "ScapegoatP_no_sz (insert + remove) " << wt[3] << " seconds (Wall Clock)" << endl;
+	return 0;
+}
+
+// The same alpha given at run time and fixed at compile time. Both pairs build identical trees, so only the balance checks differ.
+int benchFixed(int n) {
+	WBTree<int> wb_tree(0.3125);
+	BalancedTree<int, less<int>, FixedWeightBalance<5, 16> > wbf_tree;
+	Scapegoat<int> sg_tree(0.5625);
+	BalancedTree<int, less<int>, FixedScapegoatBalance<9, 16> > sgf_tree;
+	double wt[4];
+	int i;
+	for (i = 0; i < n; i++)
+		arr[i] = i;
+	random_shuffle(&arr[0], &arr[n - 1] + 1);
+
+	wt[0] = fixedOf(wb_tree, n, "WBTree (alpha 0.3125)");
+	wt[1] = fixedOf(wbf_tree, n, "WBTree (alpha 5/16)");
+	wt[2] = fixedOf(sg_tree, n, "Scapegoat (alpha 0.5625)");
+	wt[3] = fixedOf(sgf_tree, n, "Scapegoat (alpha 9/16)");
+	for (i = 0; i < 4; i++)
+		if (wt[i] < 0)
+			return -1;
+
+	cout << "WBTree    (alpha 0.3125) " << wt[0] << " seconds (Wall Clock)" << endl;
+	cout << "WBTree    (alpha 5/16)   " << wt[1] << " seconds (Wall Clock)" << endl;
+	cout << "Scapegoat (alpha 0.5625) " << wt[2] << " seconds (Wall Clock)" << endl;
+	cout << "Scapegoat (alpha 9/16)   " << wt[3] << " seconds (Wall Clock)" << endl;
+	return 0;
+}
+
+/* Auxillary function used in benchSizeT. Fills tree with keys[0..] until SizeT runs out, checks that the next insert throws
+   length_error and that every key is still found after a rebuild of the whole tree, and returns the number of keys it took */
+template <typename TREE>
+long long overflowOf(TREE& tree, const vector<int>& keys) {
+	typedef typename TREE::size_type SizeT;
+	const int limit = numeric_limits<SizeT>::max();
+	RefTree ref;
+	bool threw = false;
+	if (replayOf(tree, ref, limit, [&keys](int i) -> WorkloadOp {
+			WorkloadOp op = { WorkloadOpType::INSERT, keys[i], 1 };
+			return op;
+		}, [&keys, &threw](TREE& tree, const vector<WorkloadOp>& trace, vector<int>& results) {
+			for (size_t i = 0; i < trace.size(); i++)
+				results[i] = Workload::apply(tree, trace[i]);
+			try {
+				tree.insert(keys[trace.size()]);
+			}
+			catch (length_error&) {
+				threw = true;
+			}
+			tree.rebuild();
+		}))
+		return -1;
+	if (!threw || tree.size() != limit)
+		return -1;
+	return limit;
+}
+
+// Trees whose sizes are int16_t run into the limit of their SizeT after 32767 keys, as an int tree would after 2^31 - 1.
+// Each of them has to refuse the next key instead of wrapping around, with rebuilds and the append path working up to the limit.
+// Then the cost of 64-bit sizes, in time and memory, against the default int.
+int benchSizeT(int n) {
+	const int limit = numeric_limits<int16_t>::max();
+	vector<int> shuffled(limit + 1), sorted(limit + 1);
+	for (int i = 0; i <= limit; i++)
+		shuffled[i] = sorted[i] = i;
+	random_shuffle(shuffled.begin(), shuffled.end());
+	for (int order = 0; order < 2; order++) {
+		const vector<int>& keys = order ? sorted : shuffled;
+		BalancedTree<int, less<int>, WeightBalance, SerialRebuild, allocator<int>, NoAggregate, int16_t> wb_tree;
+		BalancedTree<int, less<int>, WeightBalance, PoolRebuild<1000, 3>, allocator<int>, NoAggregate, int16_t> wbp_tree;
+		BalancedTree<int, less<int>, ScapegoatBalance, SerialRebuild, allocator<int>, NoAggregate, int16_t> sg_tree;
+		if (overflowOf(wb_tree, keys) != limit || overflowOf(wbp_tree, keys) != limit || overflowOf(sg_tree, keys) != limit)
+			return -1;
+	}
+	cout << "int16_t sizes : " << limit << " keys, then length_error, for shuffled and sorted inserts" << endl;
+
+	// Tombstones count towards the nodes, so they are dropped before the tree refuses a key
+	BalancedTree<int, less<int>, WeightBalance, SerialRebuild, allocator<int>, NoAggregate, int16_t, true> lazy_tree;
+	lazy_tree.setLazyDelete(true);
+	int i;
+	for (i = 0; i < 32000; i++)
+		if (!lazy_tree.insert(shuffled[i]))
+			return -1;
+	for (i = 0; i < 10000; i++)
+		if (!lazy_tree.remove(shuffled[i]))
+			return -1;
+	try {
+		for (i = limit + 1; ; i++)
+			if (!lazy_tree.insert(i) || lazy_tree.size() <= 0)
+				return -1;
+	}
+	catch (length_error&) {}
+	if (lazy_tree.size() != limit)
+		return -1;
+
+	// Copies of a key that size() does not count still have a counter of their own
+	BalancedTree<int, less<int>, WeightBalance, SerialRebuild, allocator<int>, NoAggregate, int16_t, true> multi_tree;
+	multi_tree.setMultiset(true, false);
+	try {
+		for (i = 0; ; i++)
+			if (!multi_tree.insert(7) || multi_tree.count(7) != i + 1)
+				return -1;
+	}
+	catch (length_error&) {}
+	if (multi_tree.count(7) != limit || multi_tree.size() != 1)
+		return -1;
+	cout << "int16_t sizes : length_error for nodes with tombstones and for copies of a key" << endl;
+
+	WBTreeP<int> wbp_tree;
+	BalancedTree<int, less<int>, WeightBalance, PoolRebuild<WCONCUR_SIZE, WCONCUR_DEPTH>, allocator<int>, NoAggregate, long long> wbp64_tree;
+	chrono::system_clock::time_point wcts;
+	chrono::duration<double> wt1, wt2;
+	for (i = 0; i < n; i++)
+		arr[i] = i;
+	random_shuffle(&arr[0], &arr[n - 1] + 1);
+
+	perf.start();
+	wcts = chrono::system_clock::now();
+	for (i = 0; i < n; i++)
+		if (!wbp_tree.insert(arr[i]))
+			return -1;
+	wt1 = (chrono::system_clock::now() - wcts);
+	perf.stop("WBTreeP (int sizes)", n);
+
+	perf.start();
+	wcts = chrono::system_clock::now();
+	for (i = 0; i < n; i++)
+		if (!wbp64_tree.insert(arr[i]))
+			return -1;
+	wt2 = (chrono::system_clock::now() - wcts);
+	perf.stop("WBTreeP (long long sizes)", n);
+
+	cout << "WBTreeP (int sizes)       " << wt1.count() << " seconds (Wall Clock), " << wbp_tree.memoryUsage().total() << " bytes" << endl;
+	cout << "WBTreeP (long long sizes) " << wt2.count() << " seconds (Wall Clock), " << wbp64_tree.memoryUsage().total() << " bytes" << endl;
+	return 0;
+}
+
+// Logged inserts, a checkpoint of the first half of the keys, and recovery from it and the logged second half,
+// against inserting the same keys one at a time
+int benchLog(int n) {
+	const string path = "bench_treelog";
+	chrono::system_clock::time_point wcts;
+	chrono::duration<double> wt1, wt2, wt3, wt4;
+	int i;
+	for (i = 0; i < n; i++)
+		arr[i] = i;
+	random_shuffle(&arr[0], &arr[n - 1] + 1);
+	remove((path + ".log").c_str());
+	remove((path + ".ckpt").c_str());
+	{
+		WBTreeP<int> wbp_tree;
+		TreeLog<WBTreeP<int> > log(wbp_tree, path);
+		log.recover();
+		wcts = chrono::system_clock::now();
+		for (i = 0; i < n / 2; i++)
+			if (!log.insert(arr[i]))
+				return -1;
+		wt1 = (chrono::system_clock::now() - wcts);
+		wcts = chrono::system_clock::now();
+		log.checkpoint();
+		wt2 = (chrono::system_clock::now() - wcts);
+		for (; i < n; i++)
+			if (!log.insert(arr[i]))
+				return -1;
+	}
+
+	WBTreeP<int> wbp_tree;
+	perf.start();
+	wcts = chrono::system_clock::now();
+	for (i = 0; i < n; i++)
+		if (!wbp_tree.insert(arr[i]))
+			return -1;
+	wt3 = (chrono::system_clock::now() - wcts);
+	perf.stop("WBTreeP (insert one by one)", n);
+	wbp_tree.clear();
+
+	perf.start();
+	wcts = chrono::system_clock::now();
+	{
+		TreeLog<WBTreeP<int> > log(wbp_tree, path);
+		if (log.recover() != n - n / 2 || wbp_tree.size() != n)
+			return -1;
+	}
+	wt4 = (chrono::system_clock::now() - wcts);
+	perf.stop("WBTreeP (recover)", n);
+	remove((path + ".log").c_str());
+	remove((path + ".ckpt").c_str());
+
+	// An insert whose commit fails, here since the log was never opened, has to be undone on the tree
+	{
+		WBTreeP<int> tree;
+		TreeLog<WBTreeP<int> > unopened(tree, path, 1);
+		try {
+			unopened.insert(1);
+			return -1;
+		}
+		catch (const logic_error&) {}
+		if (tree.size() != 0)
+			return -1;
+	}
+
+	cout << "WBTreeP (logged insert)      " << wt1.count() << " seconds (Wall Clock)" << endl;
+	cout << "WBTreeP (checkpoint)         " << wt2.count() << " seconds (Wall Clock)" << endl;
+	cout << "WBTreeP (insert one by one)  " << wt3.count() << " seconds (Wall Clock)" << endl;
+	cout << "WBTreeP (recover)            " << wt4.count() << " seconds (Wall Clock)" << endl;
+	return 0;
+}
+
+/* Auxillary function used in benchLatency. Times each insert and then each remove of arr[0..n-1] on its own */
+template <typename TREE>
+int latencyOf(TREE& tree, int n, LatencyHistogram& ins, LatencyHistogram& rem) {
+	RefTree ref;
+	return replayOf(tree, ref, 2 * n, [n](int i) -> WorkloadOp {
+			WorkloadOp op = { i < n ? WorkloadOpType::INSERT : WorkloadOpType::REMOVE, arr[i % n], 1 };
+			return op;
+		}, [&ins, &rem](TREE& tree, const vector<WorkloadOp>& trace, vector<int>& results) {
+			for (size_t i = 0; i < trace.size(); i++) {
+				chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+				results[i] = Workload::apply(tree, trace[i]);
+				chrono::steady_clock::time_point t1 = chrono::steady_clock::now();
+				(trace[i].type == WorkloadOpType::INSERT ? ins : rem).record(chrono::duration_cast<chrono::nanoseconds>(t1 - t0).count());
+			}
+		});
+}
+
+// Tail latencies of single operations. The rare ones that trigger a large rebuild show up in p99.9 and above.
+int benchLatency(int n, bool shuffle) {
+	Scapegoat<int> s_tree;
+	ScapegoatP<int> sp_tree;
+	WBTree<int> wb_tree;
+	WBTreeP<int> wbp_tree;
+	LatencyHistogram ins[4], rem[4];
+	int i;
+	for (i = 0; i < n; i++)
+		arr[i] = i;
+	if (shuffle)
+		random_shuffle(&arr[0], &arr[n - 1] + 1);
+
+	if (latencyOf(s_tree, n, ins[0], rem[0]) || latencyOf(sp_tree, n, ins[1], rem[1]) ||
+		latencyOf(wb_tree, n, ins[2], rem[2]) || latencyOf(wbp_tree, n, ins[3], rem[3]))
+		return -1;
+
+	LatencyHistogram::header(cout);
+	ins[0].report(cout, "Scapegoat  (insert)");
+	ins[1].report(cout, "ScapegoatP (insert)");
+	rem[0].report(cout, "Scapegoat  (remove)");
+	rem[1].report(cout, "ScapegoatP (remove)");
+	ins[2].report(cout, "WBTree  (insert)");
+	ins[3].report(cout, "WBTreeP (insert)");
+	rem[2].report(cout, "WBTree  (remove)");
+	rem[3].report(cout, "WBTreeP (remove)");
+	return 0;
+}
+
+// Rebuilds, serial or parallel, against rotations : total time for n inserts and n removes, then the tails of single operations
+int benchRotation(int n, bool shuffle) {
+	WBTree<int> wb_tree;
+	WBTreeP<int> wbp_tree;		// WBTreeTP is the same type
+	WBTreeR<int> wbr_tree;
+	LatencyHistogram ins[3], rem[3];
+	double wt[3];
+	int i;
+	for (i = 0; i < n; i++)
+		arr[i] = i;
+	if (shuffle)
+		random_shuffle(&arr[0], &arr[n - 1] + 1);
+
+	wt[0] = fixedOf(wb_tree, n, "WBTree");
+	wt[1] = fixedOf(wbp_tree, n, "WBTreeP");
+	wt[2] = fixedOf(wbr_tree, n, "WBTreeR");
+	for (i = 0; i < 3; i++)
+		if (wt[i] < 0)
+			return -1;
+	if (latencyOf(wb_tree, n, ins[0], rem[0]) || latencyOf(wbp_tree, n, ins[1], rem[1]) || latencyOf(wbr_tree, n, ins[2], rem[2]))
+		return -1;
+
+	cout << "WBTree  (insert + remove) " << wt[0] << " seconds (Wall Clock)" << endl;
+	cout << "WBTreeP (insert + remove) " << wt[1] << " seconds (Wall Clock)" << endl;
+	cout << "WBTreeR (insert + remove) " << wt[2] << " seconds (Wall Clock)" << endl;
+	LatencyHistogram::header(cout);
+	ins[0].report(cout, "WBTree  (insert)");
+	ins[1].report(cout, "WBTreeP (insert)");
+	ins[2].report(cout, "WBTreeR (insert)");
+	rem[0].report(cout, "WBTree  (remove)");
+	rem[1].report(cout, "WBTreeP (remove)");
+	rem[2].report(cout, "WBTreeR (remove)");
+	return 0;
+}
+
+// Scapegoat trees whose removes rebuild the whole tree once it has shrunk to half, against local delete mode :
+// total time for n inserts and n removes, then the tails of single operations
+int benchLocalDelete(int n, bool shuffle) {
+	Scapegoat<int> s_tree, sl_tree;
+	ScapegoatP<int> sp_tree, spl_tree;
+	BalancedTree<int, less<int>, FixedScapegoatBalance<9, 16>, SerialRebuild> fl_tree;	// The alpha of Scapegoat, fixed
+	LatencyHistogram ins[4], rem[4];
+	double wt[5];
+	int i;
+	sl_tree.setLocalDelete(true);
+	spl_tree.setLocalDelete(true);
+	fl_tree.setLocalDelete(true);
+	try {
+		WBTreeR<int>().setLocalDelete(true);	// Its deletes are local anyway, so the mode is rejected
+		return -1;
+	}
+	catch (const logic_error&) {}
+	for (i = 0; i < n; i++)
+		arr[i] = i;
+	if (shuffle)
+		random_shuffle(&arr[0], &arr[n - 1] + 1);
+
+	wt[0] = fixedOf(s_tree, n, "Scapegoat");
+	wt[1] = fixedOf(sl_tree, n, "Scapegoat (local)");
+	wt[2] = fixedOf(sp_tree, n, "ScapegoatP");
+	wt[3] = fixedOf(spl_tree, n, "ScapegoatP (local)");
+	wt[4] = fixedOf(fl_tree, n, "Scapegoat<9/16> (local)");
+	for (i = 0; i < 5; i++)
+		if (wt[i] < 0)
+			return -1;
+	if (latencyOf(s_tree, n, ins[0], rem[0]) || latencyOf(sl_tree, n, ins[1], rem[1]) ||
+		latencyOf(sp_tree, n, ins[2], rem[2]) || latencyOf(spl_tree, n, ins[3], rem[3]))
+		return -1;
+
+	cout << "Scapegoat          (insert + remove) " << wt[0] << " seconds (Wall Clock)" << endl;
+	cout << "Scapegoat  (local) (insert + remove) " << wt[1] << " seconds (Wall Clock)" << endl;
+	cout << "ScapegoatP         (insert + remove) " << wt[2] << " seconds (Wall Clock)" << endl;
+	cout << "ScapegoatP (local) (insert + remove) " << wt[3] << " seconds (Wall Clock)" << endl;
+	cout << "Scapegoat<9/16> (local) (insert + remove) " << wt[4] << " seconds (Wall Clock)" << endl;
+	LatencyHistogram::header(cout);
+	rem[0].report(cout, "Scapegoat  (remove)");
+	rem[1].report(cout, "Scapegoat  (local)");
+	rem[2].report(cout, "ScapegoatP (remove)");
+	rem[3].report(cout, "ScapegoatP (local)");
+	return 0;
+}
+
+/* Auxillary function used in benchWorkload. Loads tree, then times replaying trace on it */
+template <typename TREE>
+int workloadOf(TREE& tree, const string& name, const vector<int>& load, const vector<WorkloadOp>& trace) {
+	RefTree ref;
+	double wt;
+	for (size_t i = 0; i < load.size(); i++)
+		if (!tree.insert(load[i]) || !ref.insert(load[i]))
+			return -1;
+	if (replayOf(tree, ref, trace.size(), [&trace](int i) { return trace[i]; }, TimedRun(name, wt)))
+		return -1;
+	tree.clear();
+	cout << name << " " << wt << " seconds (Wall Clock), " << trace.size() / wt / 1e6 << " Mops/s" << endl;
+	return 0;
+}
+
+/* Replays one trace on every tree. Alpha is used by the trees whose balance policy accepts it, the others keep their default */
+int workloadAll(const string& label, double alpha, const vector<int>& load, const vector<WorkloadOp>& trace) {
+	double sgAlpha = ScapegoatBalance::validAlpha(alpha) ? alpha : ScapegoatBalance::defaultAlpha();
+	double wbAlpha = WeightBalance::validAlpha(alpha) ? alpha : WeightBalance::defaultAlpha();
+	Scapegoat<int> s_tree(sgAlpha);
+	ScapegoatP<int> sp_tree(sgAlpha);
+	WBTree<int> wb_tree(wbAlpha);
+	WBTreeP<int> wbp_tree(wbAlpha);
+	WBTreeC<int> wbc_tree(wbAlpha);
+	WBTreeR<int> wbr_tree;	// Rotations keep their own fixed balance, so alpha does not apply
+	cout << label << endl;
+	if (workloadOf(s_tree, "  Scapegoat ", load, trace) || workloadOf(sp_tree, "  ScapegoatP", load, trace) ||
+		workloadOf(wb_tree, "  WBTree    ", load, trace) || workloadOf(wbp_tree, "  WBTreeP   ", load, trace) ||
+		workloadOf(wbc_tree, "  WBTreeC   ", load, trace) || workloadOf(wbr_tree, "  WBTreeR   ", load, trace))
+		return -1;
+	return 0;
+}
+
+// Every operation mix of Workload.h on n preloaded keys, then the adversarial insertion orders on n keys
+int benchWorkload(int n, int ops, double alpha) {
+	Workload w(n);
+	vector<int> load = w.load(), none;
+	for (int i = 0; i < WORKLOAD_MIX_COUNT; i++)
+		if (workloadAll(WORKLOAD_MIXES[i].name, alpha, load, w.trace(WORKLOAD_MIXES[i], ops)))
+			return -1;
+	if (workloadAll("Zig-zag inserts and removes", alpha, none, Workload::zigzag(n)) ||
+		workloadAll("Sorted blocks of 64, inserts and removes", alpha, none, w.sortedBlocks(n, 64)))
+		return -1;
+	return 0;
+}
+
+/* Auxillary function used in benchMultiset. Replays ops random inserts and removes of keys distinct keys, checks count, rank and size
+   of every key against the reference afterwards, and returns the time taken */
+template <typename TREE>
+double multisetOf(TREE& tree, bool countCopies, int ops, int keys, const string& name) {
+	RefTree ref(true);
+	mt19937 rng(1);
+	uniform_int_distribution<int> key(0, keys - 1), pct(0, 99);
+	double wt;
+	if (replayOf(tree, ref, ops, [&](int i) -> WorkloadOp {
+			WorkloadOp op = { pct(rng) < 60 ? WorkloadOpType::INSERT : WorkloadOpType::REMOVE, 0, 1 };
+			op.key = key(rng);
+			return op;
+		}, TimedRun(name, wt)))
+		return -1;
+	if (tree.size() != ref.size(countCopies))
+		return -1;
+	for (int k = 0; k < keys; k++)
+		if (tree.count(k) != ref.count(k) || tree.rank(k) != ref.rank(k, countCopies))
+			return -1;
+	return wt;
+}
+
+// Multiset mode on a few distinct keys with many copies each, checked against std::map, with size() and rank()
+// counting every copy and counting distinct keys
+int benchMultiset(int ops) {
+	const int keys = 1000;
+	WBTreeM<int> wb_tree, wbd_tree;
+	WBTreePM<int> wbp_tree;
+	ScapegoatM<int> s_tree;
+	double wt[4];
+	wb_tree.setMultiset(true);
+	wbd_tree.setMultiset(true, false);
+	wbp_tree.setMultiset(true);
+	s_tree.setMultiset(true);
+	wt[0] = multisetOf(wb_tree, true, ops, keys, "WBTree (copies)");
+	wt[1] = multisetOf(wbd_tree, false, ops, keys, "WBTree (distinct)");
+	wt[2] = multisetOf(wbp_tree, true, ops, keys, "WBTreeP (copies)");
+	wt[3] = multisetOf(s_tree, true, ops, keys, "Scapegoat (copies)");
+	for (int i = 0; i < 4; i++)
+		if (wt[i] < 0)
+			return -1;
+	cout << "Multiset, " << ops << " inserts and removes of " << keys << " keys, checked against std::map" << endl;
+	cout << "WBTree    (copies)   " << wt[0] << " seconds (Wall Clock), " << wb_tree.memoryUsage().nodes << " bytes of nodes" << endl;
+	cout << "WBTree    (distinct) " << wt[1] << " seconds (Wall Clock)" << endl;
+	cout << "WBTreeP   (copies)   " << wt[2] << " seconds (Wall Clock)" << endl;
+	cout << "Scapegoat (copies)   " << wt[3] << " seconds (Wall Clock)" << endl;
+	return 0;
+}
+
+/* Auxillary function used in benchLazyDelete. Loads arr[0..n-1] into tree, then replays ops random removes, inserts and searches,
+   mostly removes, and returns the time they took */
+template <typename TREE>
+double lazyOf(TREE& tree, int n, int ops, const string& name) {
+	RefTree ref;
+	mt19937 rng(1);
+	uniform_int_distribution<int> key(0, 2 * n - 1), pct(0, 99);
+	double wt;
+	for (int i = 0; i < n; i++)
+		if (!tree.insert(arr[i]) || !ref.insert(arr[i]))
+			return -1;
+	if (replayOf(tree, ref, ops, [&](int i) -> WorkloadOp {
+			int p = pct(rng);
+			WorkloadOp op = { p < 50 ? WorkloadOpType::REMOVE : p < 75 ? WorkloadOpType::INSERT : WorkloadOpType::SEARCH, key(rng), 1 };
+			return op;
+		}, TimedRun(name, wt)))
+		return -1;
+	return tree.size() == ref.size(false) ? wt : -1;
+}
+
+// Delete-heavy operations with removes that unlink nodes and with lazy deletes that leave tombstones, checked against std::map
+int benchLazyDelete(int n, int ops) {
+	WBTree<int> wb_tree;
+	WBTreeM<int> wbl_tree;
+	Scapegoat<int> s_tree;
+	ScapegoatM<int> sl_tree;
+	double wt[4];
+	int i;
+	wbl_tree.setLazyDelete(true);
+	sl_tree.setLazyDelete(true);
+	for (i = 0; i < n; i++)
+		arr[i] = 2 * i;
+	random_shuffle(&arr[0], &arr[n - 1] + 1);
+
+	wt[0] = lazyOf(wb_tree, n, ops, "WBTree");
+	wt[1] = lazyOf(wbl_tree, n, ops, "WBTree (lazy)");
+	wt[2] = lazyOf(s_tree, n, ops, "Scapegoat");
+	wt[3] = lazyOf(sl_tree, n, ops, "Scapegoat (lazy)");
+	for (i = 0; i < 4; i++)
+		if (wt[i] < 0)
+			return -1;
+	cout << n << " keys, then " << ops << " removes, inserts and searches, checked against std::map" << endl;
+	cout << "WBTree           " << wt[0] << " seconds (Wall Clock)" << endl;
+	cout << "WBTree    (lazy) " << wt[1] << " seconds (Wall Clock)" << endl;
+	cout << "Scapegoat        " << wt[2] << " seconds (Wall Clock)" << endl;
+	cout << "Scapegoat (lazy) " << wt[3] << " seconds (Wall Clock)" << endl;
+	return 0;
+}
+
+/* Auxillary function used in benchAdaptive. Loads arr[0..n-1] into tree, then replays phases of ops operations each,
+   reads percent searches and the rest inserts and removes, and prints the time and the alpha after each phase */
+template <typename TREE>
+int adaptiveOf(TREE& tree, int n, const int* reads, int phases, int ops, const string& name) {
+	RefTree ref;
+	mt19937 rng(1);
+	uniform_int_distribution<int> key(0, 2 * n - 1), pct(0, 99);
+	for (int i = 0; i < n; i++)
+		if (!tree.insert(arr[i]) || !ref.insert(arr[i]))
+			return -1;
+	cout << left << setw(22) << name << right;
+	int result = replayOf(tree, ref, phases * ops, [&](int i) -> WorkloadOp {
+			int p = pct(rng);
+			WorkloadOp op = { p < reads[i / ops] ? WorkloadOpType::SEARCH : p % 2 ? WorkloadOpType::INSERT : WorkloadOpType::REMOVE, key(rng), 1 };
+			return op;
+		}, [ops](TREE& tree, const vector<WorkloadOp>& trace, vector<int>& results) {
+			for (size_t ph = 0; ph < trace.size(); ph += ops) {
+				chrono::system_clock::time_point wcts = chrono::system_clock::now();
+				for (size_t i = ph; i < ph + ops; i++)
+					results[i] = Workload::apply(tree, trace[i]);
+				chrono::duration<double> wt = chrono::system_clock::now() - wcts;
+				cout << fixed << setprecision(4) << setw(12) << wt.count() << setprecision(3) << setw(8) << tree.getAlpha();
+			}
+		});
+	cout.unsetf(ios::fixed);
+	cout << setprecision(6) << endl;
+	if (result || tree.size() != ref.size(false))
+		return -1;
+	return 0;
+}
+
+// Phases that swing between writes and reads. Adaptive trees loosen alpha for the writes and tighten it for the reads,
+// trees with a fixed alpha keep theirs. Each phase lasts several adaptation windows.
+int benchAdaptive(int n) {
+	const int reads[] = { 10, 95, 10, 95 }, phases = 4;
+	int ops = 4 * max(ADAPT_WINDOW, n), i;
+	WBTree<int> wb_tree, wba_tree;
+	Scapegoat<int> s_tree, sa_tree;
+	wba_tree.setAdaptive(true);
+	sa_tree.setAdaptive(true);
+	for (i = 0; i < n; i++)
+		arr[i] = 2 * i;
+	random_shuffle(&arr[0], &arr[n - 1] + 1);
+
+	cout << left << setw(22) << "(seconds, alpha)" << right;
+	for (i = 0; i < phases; i++)
+		cout << setw(12) << (to_string(reads[i]) + "% reads") << setw(8) << "";
+	cout << endl;
+	if (adaptiveOf(wb_tree, n, reads, phases, ops, "WBTree") ||
+		adaptiveOf(wba_tree, n, reads, phases, ops, "WBTree (adaptive)") ||
+		adaptiveOf(s_tree, n, reads, phases, ops, "Scapegoat") ||
+		adaptiveOf(sa_tree, n, reads, phases, ops, "Scapegoat (adaptive)"))
+		return -1;
+	return 0;
+}
+
+/* Auxillary function used in benchMemory. Inserts arr[0..n-1], which holds 0..n-1, rebuilds the whole tree, checks that every key
+   is found at its rank, also after a dump, assign, freeze and thaw, and returns the time taken */
+template <typename TREE>
+double memoryOf(TREE& tree, int n, const string& name) {
+	RefTree ref;
+	double wt;
+	if (replayOf(tree, ref, n, [](int i) -> WorkloadOp {
+			WorkloadOp op = { WorkloadOpType::INSERT, arr[i], 1 };
+			return op;
+		}, [&name, &wt](TREE& tree, const vector<WorkloadOp>& trace, vector<int>& results) {
+			chrono::system_clock::time_point wcts = chrono::system_clock::now();
+			perf.start();
+			for (size_t i = 0; i < trace.size(); i++)
+				results[i] = Workload::apply(tree, trace[i]);
+			tree.rebuild();
+			perf.stop(name, trace.size());
+			wt = chrono::duration<double>(chrono::system_clock::now() - wcts).count();
+		}))
+		return -1;
+	if (tree.size() != n)
+		return -1;
+	for (int k = 0; k < n; k++)
+		if (tree.rank(k) != k)
+			return -1;
+	// A checkpoint and a freeze have to keep every key too, and take no more scratch than a rebuild
+	vector<int> keys;
+	vector<typename TREE::size_type> counts;
+	tree.dump(keys, counts);
+	tree.assign(keys, counts);
+	tree.freeze();
+	tree.thaw();
+	if (tree.size() != n || (int)keys.size() != n)
+		return -1;
+	for (int k = 0; k < n; k++)
+		if (keys[k] != k || tree.rank(k) != k)
+			return -1;
+	return wt;
+}
+
+/* Auxillary function used in benchMemory */
+void reportMemory(const string& name, double wt, const MemoryUsage& m) {
+	cout << left << setw(22) << name << right << setw(10) << wt << setw(12) << m.nodes << setw(12) << m.overhead
+		<< setw(12) << m.scratch << setw(12) << m.scratchPeak << setw(12) << m.stacks << setw(12) << m.peak() << endl;
+}
+
+// What memoryUsage() reports after n shuffled inserts and a rebuild of the whole tree, then the same with a scratch limit
+// far below the array a rebuild needs, which makes every larger rebuild relink its nodes in place
+int benchMemory(int n) {
+	const size_t limit = 4096;
+	WBTree<int> wb_tree, wbl_tree;
+	WBTreeP<int> wbp_tree, wbpl_tree;
+	Scapegoat<int> s_tree, sl_tree;
+	double wt[6];
+	int i;
+	wbl_tree.setScratchLimit(limit);
+	wbpl_tree.setScratchLimit(limit);
+	sl_tree.setScratchLimit(limit);
+	for (i = 0; i < n; i++)
+		arr[i] = i;
+	random_shuffle(&arr[0], &arr[n - 1] + 1);
+
+	wt[0] = memoryOf(wb_tree, n, "WBTree");
+	wt[1] = memoryOf(wbl_tree, n, "WBTree (in place)");
+	wt[2] = memoryOf(wbp_tree, n, "WBTreeP");
+	wt[3] = memoryOf(wbpl_tree, n, "WBTreeP (in place)");
+	wt[4] = memoryOf(s_tree, n, "Scapegoat");
+	wt[5] = memoryOf(sl_tree, n, "Scapegoat (in place)");
+	for (i = 0; i < 6; i++)
+		if (wt[i] < 0)
+			return -1;
+	if (wbl_tree.memoryUsage().scratchPeak > limit || wbpl_tree.memoryUsage().scratchPeak > limit || sl_tree.memoryUsage().scratchPeak > limit)
+		return -1;
+
+	cout << left << setw(22) << "(bytes)" << right << setw(10) << "seconds" << setw(12) << "nodes" << setw(12) << "overhead"
+		<< setw(12) << "scratch" << setw(12) << "scratch max" << setw(12) << "stacks" << setw(12) << "peak" << endl;
+	reportMemory("WBTree", wt[0], wb_tree.memoryUsage());
+	reportMemory("WBTree (in place)", wt[1], wbl_tree.memoryUsage());
+	reportMemory("WBTreeP", wt[2], wbp_tree.memoryUsage());
+	reportMemory("WBTreeP (in place)", wt[3], wbpl_tree.memoryUsage());
+	reportMemory("Scapegoat", wt[4], s_tree.memoryUsage());
+	reportMemory("Scapegoat (in place)", wt[5], sl_tree.memoryUsage());
+	return 0;
+}
+
+/* Auxillary function used in benchAggregate. Loads arr[0..n-1] into tree, then replays ops rounds of a random insert or remove
+   followed by rangeAggregate over a random range of up to 2000 keys. Returns the time taken, and sets scan to the time the reference
+   takes to fold the same ranges key by key, or returns -1 if a result differs from that fold */
+template <typename AGG, typename TREE>
+double aggregateOf(TREE& tree, int n, int ops, double& scan, const string& name) {
+	typedef typename AGG::value_type V;
+	RefTree ref;
+	vector<V> aggs(ops);
+	mt19937 rng(1);
+	uniform_int_distribution<int> key(0, 2 * n - 1), len(0, 2000);
+	chrono::duration<double> folding(0);
+	double wt;
+	for (int i = 0; i < n; i++)
+		if (!tree.insert(arr[i]) || !ref.insert(arr[i]))
+			return -1;
+	if (replayOf(tree, ref, ops, [&](int i) -> WorkloadOp {
+			WorkloadOp op = { rng() % 2 ? WorkloadOpType::INSERT : WorkloadOpType::REMOVE, 0, 0 };
+			op.key = key(rng);
+			op.len = len(rng);
+			return op;
+		}, [&](TREE& tree, const vector<WorkloadOp>& trace, vector<int>& results) {
+			chrono::system_clock::time_point wcts = chrono::system_clock::now();
+			perf.start();
+			for (size_t i = 0; i < trace.size(); i++) {
+				results[i] = Workload::apply(tree, trace[i]);
+				aggs[i] = tree.rangeAggregate(trace[i].key, trace[i].key + trace[i].len);
+			}
+			perf.stop(name, trace.size());
+			wt = chrono::duration<double>(chrono::system_clock::now() - wcts).count();
+		}, [&](int i, const WorkloadOp& op, RefTree& ref) {
+			chrono::system_clock::time_point wcts = chrono::system_clock::now();
+			V fold = AGG::identity();
+			for (map<int, long long>::iterator it = ref.keys.lower_bound(op.key); it != ref.keys.end() && it->first <= op.key + op.len; ++it)
+				fold = AGG::combine(fold, AGG::of(it->first, it->second));
+			folding += chrono::system_clock::now() - wcts;
+			return fold == aggs[i];
+		}))
+		return -1;
+	scan = folding.count();
+	return wt;
+}
+
+// rangeAggregate with each aggregate policy against folding the keys of the range one by one, on trees that are updated in between
+int benchAggregate(int n, int ops) {
+	BalancedTree<int, less<int>, WeightBalance, SerialRebuild, allocator<int>, SumAggregate<int, long long> > sum_tree;
+	BalancedTree<int, less<int>, WeightBalance, PoolRebuild<WCONCUR_SIZE, WCONCUR_DEPTH>, allocator<int>, MinAggregate<int> > min_tree;
+	BalancedTree<int, less<int>, ScapegoatBalance, SerialRebuild, allocator<int>, MaxAggregate<int> > max_tree;
+	double wt[3], scan[3];
+	int i;
+	for (i = 0; i < n; i++)
+		arr[i] = 2 * i;
+	random_shuffle(&arr[0], &arr[n - 1] + 1);
+
+	wt[0] = aggregateOf<SumAggregate<int, long long> >(sum_tree, n, ops, scan[0], "WBTree (sum)");
+	wt[1] = aggregateOf<MinAggregate<int> >(min_tree, n, ops, scan[1], "WBTreeP (min)");
+	wt[2] = aggregateOf<MaxAggregate<int> >(max_tree, n, ops, scan[2], "Scapegoat (max)");
+	for (i = 0; i < 3; i++)
+		if (wt[i] < 0)
+			return -1;
+	cout << ops << " updates and range aggregates on " << n << " keys, checked against folding std::map ranges" << endl;
+	cout << "WBTree    (sum) " << wt[0] << " seconds (Wall Clock), folding " << scan[0] << " seconds" << endl;
+	cout << "WBTreeP   (min) " << wt[1] << " seconds (Wall Clock), folding " << scan[1] << " seconds" << endl;
+	cout << "Scapegoat (max) " << wt[2] << " seconds (Wall Clock), folding " << scan[2] << " seconds" << endl;
+	return 0;
+}
+
+int main(int argc, char* argv[]) {
+	bool latency = false, workload = false, log = false, fixed = false, sizes = false, rotation = false, localDelete = false, noSize = false, multi = false, lazy = false, adapt = false, memory = false, aggregate = false, compact = false, batch = false, range = false, scan = false;
+	double alpha = 0;
+	for (int i = 1; i < argc; i++) {
+		if (string(argv[i]) == "--perf" && !perf.enable())
+			cout << "Hardware counters unavailable (" << perf.why() << "), reporting wall clock only" << endl;
+		if (string(argv[i]) == "--latency")
+			latency = true;
+		if (string(argv[i]) == "--workload")
+			workload = true;
+		if (string(argv[i]) == "--log")
+			log = true;
+		if (string(argv[i]) == "--fixed")
+			fixed = true;
+		if (string(argv[i]) == "--sizes")
+			sizes = true;
+		if (string(argv[i]) == "--rotation")
+			rotation = true;
+		if (string(argv[i]) == "--local-delete")
+			localDelete = true;
+		if (string(argv[i]) == "--no-size")
+			noSize = true;
+		if (string(argv[i]) == "--multiset")
+			multi = true;
+		if (string(argv[i]) == "--lazy")
+			lazy = true;
+		if (string(argv[i]) == "--adaptive")
+			adapt = true;
+		if (string(argv[i]) == "--memory")
+			memory = true;
+		if (string(argv[i]) == "--aggregate")
+			aggregate = true;
+		if (string(argv[i]) == "--compact")
+			compact = true;
+		if (string(argv[i]) == "--batch")
+			batch = true;
+		if (string(argv[i]) == "--range")
+			range = true;
+		if (string(argv[i]) == "--scan")
+			scan = true;
+		if (string(argv[i]) == "--alpha" && i + 1 < argc)
+			alpha = atof(argv[++i]);
+	}
+	if (latency) {
+		if (benchLatency(N, true)) {
+			cout << "A tree lost a key" << endl;
+			return 1;
+		}
+		return 0;
+	}
+	if (rotation) {
+		if (benchRotation(N, true) || benchRotation(N, false)) {
+			cout << "A tree lost a key" << endl;
+			return 1;
+		}
+		return 0;
+	}
+	if (multi) {
+		if (benchMultiset(N / 10)) {
+			cout << "A tree disagrees with std::map" << endl;
+			return 1;
+		}
+		return 0;
+	}
+	if (lazy) {
+		if (benchLazyDelete(N / 10, N / 10)) {
+			cout << "A tree disagrees with std::map" << endl;
+			return 1;
+		}
+		return 0;
+	}
+	if (adapt) {
+		if (benchAdaptive(N / 100)) {
+			cout << "A tree disagrees with std::map" << endl;
+			return 1;
+		}
+		return 0;
+	}
+	if (memory) {
+		if (benchMemory(N)) {
+			cout << "A tree lost a key or went over its scratch limit" << endl;
+			return 1;
+		}
+		return 0;
+	}
+	if (aggregate) {
+		if (benchAggregate(N / 10, N / 100)) {
+			cout << "A tree disagrees with folding std::map" << endl;
+			return 1;
+		}
+		return 0;
+	}
+	if (compact) {
+		if (benchAllC(N, true) || benchAllC(N, false)) {
+			cout << "A tree lost a key" << endl;
+			return 1;
+		}
+		return 0;
+	}
+	if (batch) {
+		if (benchSearchW(N, 256)) {
+			cout << "Lookups disagree" << endl;
+			return 1;
+		}
+		return 0;
+	}
+	if (range) {
+		if (benchRangeW(N)) {
+			cout << "A tree removed the wrong keys" << endl;
+			return 1;
+		}
+		return 0;
+	}
+	if (scan) {
+		if (benchScanW(N)) {
+			cout << "Sums disagree" << endl;
+			return 1;
+		}
+		return 0;
+	}
+	if (noSize) {
+		if (benchNoSize(N, true) || benchNoSize(N, false)) {
+			cout << "A tree lost a key" << endl;
+			return 1;
+		}
+		return 0;
+	}
+	if (localDelete) {
+		if (benchLocalDelete(N, true) || benchLocalDelete(N, false)) {
+			cout << "A tree lost a key" << endl;
+			return 1;
+		}
+		return 0;
+	}
+	if (sizes) {
+		if (benchSizeT(N)) {
+			cout << "A tree overflowed its SizeT" << endl;
+			return 1;
+		}
+		return 0;
+	}
+	if (fixed) {
+		if (benchFixed(N)) {
+			cout << "A tree lost a key" << endl;
+			return 1;
+		}
+		return 0;
+	}
+	if (log) {
+		if (benchLog(N)) {
+			cout << "Recovered tree differs" << endl;
+			return 1;
+		}
+		return 0;
+	}
+	if (workload) {
+		if (benchWorkload(N / 10, N / 10, alpha)) {
+			cout << "Trees disagree on a workload" << endl;
+			return 1;
+		}
+		return 0;
+	}
+	if (benchRebuildW(N, true) || benchAllW(N, false)) {
+		cout << "A tree lost a key" << endl;
+		return 1;
+	}
 	return 0;
 }